@@ -0,0 +1,73 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Синтетический корпус для бенчмарков: слова словаря встречаются по закону
+// Ципфа (частота ранга r ~ 1 / r^s), как в естественных текстах.
+struct CorpusConfig {
+    size_t docs = 20000;          // число документов
+    size_t words_per_doc = 200;   // средняя длина документа в словах
+    size_t vocabulary = 50000;    // размер словаря
+    double zipf_s = 1.07;         // показатель распределения
+    uint32_t seed = 42;
+};
+
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(const CorpusConfig& cfg) : cfg_(cfg), rng_(cfg.seed) {
+        words_.reserve(cfg.vocabulary);
+        for (size_t r = 0; r < cfg.vocabulary; ++r) words_.push_back(word_for_rank(r));
+        cdf_.reserve(cfg.vocabulary);
+        double sum = 0;
+        for (size_t r = 0; r < cfg.vocabulary; ++r) {
+            sum += 1.0 / std::pow(double(r + 1), cfg.zipf_s);
+            cdf_.push_back(sum);
+        }
+        for (auto& c : cdf_) c /= sum;
+    }
+
+    // слово заданного ранга (0 — самое частое)
+    const std::string& word(size_t rank) const { return words_[rank]; }
+
+    size_t sample_rank() {
+        const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng_);
+        return std::min(size_t(std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin()), cdf_.size() - 1);
+    }
+
+    std::string document() {
+        std::uniform_int_distribution<size_t> len(cfg_.words_per_doc / 2, cfg_.words_per_doc * 3 / 2);
+        const size_t n = len(rng_);
+        std::string doc;
+        doc.reserve(n * 8);
+        for (size_t i = 0; i < n; ++i) {
+            doc += words_[sample_rank()];
+            doc += ' ';
+        }
+        return doc;
+    }
+
+    std::vector<std::string> corpus() {
+        std::vector<std::string> docs;
+        docs.reserve(cfg_.docs);
+        for (size_t i = 0; i < cfg_.docs; ++i) docs.push_back(document());
+        return docs;
+    }
+
+private:
+    // ранг -> уникальное слово из латинских букв
+    static std::string word_for_rank(size_t r) {
+        std::string w;
+        do { w += char('a' + r % 26); r /= 26; } while (r);
+        return w + "x";
+    }
+
+    CorpusConfig cfg_;
+    std::mt19937 rng_;
+    std::vector<std::string> words_;
+    std::vector<double> cdf_;
+};
@@ -0,0 +1,311 @@
+// Бенчмарки горячих путей индексации и поиска (Google Benchmark).
+// Размер корпуса задаётся переменными окружения SE_BENCH_DOCS,
+// SE_BENCH_DOC_WORDS, SE_BENCH_VOCAB. Машиночитаемый отчёт для сравнения
+// сборок: --benchmark_format=json или --benchmark_out=<file>.json.
+#include "CorpusGenerator.h"
+#include "InvertedIndex.h"
+#include "SearchServer.h"
+#include "Tokenizer.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static size_t env_or(const char* name, size_t def) {
+    const char* v = std::getenv(name);
+    return v ? static_cast<size_t>(std::strtoull(v, nullptr, 10)) : def;
+}
+
+// пиковый RSS процесса, МБ
+static double peak_rss_mb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+    return double(pmc.PeakWorkingSetSize) / (1024.0 * 1024.0);
+#else
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return double(ru.ru_maxrss) / 1024.0; // Linux: КБ
+#endif
+}
+
+static void report_memory(benchmark::State& state) {
+    state.counters["peak_rss_mb"] = benchmark::Counter(peak_rss_mb(), benchmark::Counter::kAvgThreads);
+}
+
+// ---- общий корпус и индекс, строятся один раз ----
+struct Fixture {
+    CorpusConfig cfg;
+    std::unique_ptr<CorpusGenerator> gen;
+    std::vector<std::string> docs;
+    InvertedIndex index;
+
+    Fixture() {
+        cfg.docs = env_or("SE_BENCH_DOCS", cfg.docs);
+        cfg.words_per_doc = env_or("SE_BENCH_DOC_WORDS", cfg.words_per_doc);
+        cfg.vocabulary = env_or("SE_BENCH_VOCAB", cfg.vocabulary);
+        gen = std::make_unique<CorpusGenerator>(cfg);
+        docs = gen->corpus();
+        index.UpdateDocumentBase(docs);
+    }
+
+    // частые слова — из головы распределения, редкие — из хвоста
+    std::string high(size_t i) const { return gen->word(i % 50); }
+    std::string low(size_t i) const { return gen->word(cfg.vocabulary / 20 + (i * 37) % (cfg.vocabulary / 20)); }
+};
+
+static Fixture& fixture() {
+    static Fixture f;
+    return f;
+}
+
+// ---- токенизация ----
+static void BM_Tokenize(benchmark::State& state) {
+    const auto& docs = fixture().docs;
+    size_t bytes = 0, tokens = 0;
+    for (auto _ : state) {
+        for (const auto& d : docs) {
+            Tokenizer tok(d);
+            std::string_view w;
+            while (tok.next(w)) ++tokens;
+            bytes += d.size();
+        }
+    }
+    benchmark::DoNotOptimize(tokens);
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    report_memory(state);
+}
+BENCHMARK(BM_Tokenize)->Unit(benchmark::kMillisecond);
+
+// ---- индексация при разном числе потоков ----
+static void BM_UpdateDocumentBase(benchmark::State& state) {
+    const auto& docs = fixture().docs;
+    for (auto _ : state) {
+        InvertedIndex idx;
+        idx.setThreadCount(static_cast<size_t>(state.range(0)));
+        idx.UpdateDocumentBase(docs);
+        benchmark::DoNotOptimize(idx.MemoryUsage());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * docs.size()));
+    report_memory(state);
+}
+BENCHMARK(BM_UpdateDocumentBase)->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// ---- GetWordCount: частое и редкое слово ----
+static void BM_GetWordCount(benchmark::State& state) {
+    auto& f = fixture();
+    const bool high = state.range(0) != 0;
+    size_t i = 0, postings = 0;
+    for (auto _ : state) {
+        const auto list = f.index.GetWordCount(high ? f.high(i) : f.low(i));
+        postings += list.size();
+        ++i;
+    }
+    state.counters["postings_per_call"] = double(postings) / double(std::max<size_t>(i, 1));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    report_memory(state);
+}
+BENCHMARK(BM_GetWordCount)->ArgName("high")->Arg(1)->Arg(0);
+
+// ---- поиск: 1, 3, 10 слов; частые и редкие; p50/p99 ----
+static void run_search(benchmark::State& state, SearchServer::Ranking ranking,
+                       SearchServer::Match match = SearchServer::Match::All,
+                       float dense_fraction = 0.1f, const InvertedIndex* index = nullptr) {
+    auto& f = fixture();
+    const size_t terms = static_cast<size_t>(state.range(0));
+    const bool high = state.range(1) != 0;
+
+    std::vector<std::string> queries;
+    for (size_t q = 0; q < 64; ++q) {
+        std::string query;
+        for (size_t t = 0; t < terms; ++t) {
+            // у запроса из редких слов одно частое, чтобы AND не был всегда пуст
+            query += (high || t == 0) ? f.high(q * 7 + t) : f.low(q * 13 + t);
+            query += ' ';
+        }
+        queries.push_back(query);
+    }
+
+    SearchServer srv(index ? *index : f.index);
+    srv.setRanking(ranking);
+    srv.setMatch(match);
+    srv.setDenseFraction(dense_fraction);
+    std::vector<double> lat;
+    lat.reserve(4096);
+    size_t i = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        auto res = srv.search({ queries[i++ % queries.size()] });
+        const auto t1 = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(res);
+        lat.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+    }
+    std::sort(lat.begin(), lat.end());
+    if (!lat.empty()) {
+        state.counters["p50_us"] = lat[lat.size() / 2];
+        state.counters["p99_us"] = lat[std::min(lat.size() - 1, lat.size() * 99 / 100)];
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    report_memory(state);
+}
+static void BM_Search(benchmark::State& state) {
+    run_search(state, SearchServer::Ranking::Count);
+}
+BENCHMARK(BM_Search)->ArgNames({"terms", "high"})
+    ->Args({1, 1})->Args({1, 0})->Args({3, 1})->Args({3, 0})->Args({10, 1})->Args({10, 0});
+
+// ---- те же запросы с BM25: цена длин документов и весов слов ----
+static void BM_SearchBm25(benchmark::State& state) {
+    run_search(state, SearchServer::Ranking::Bm25);
+}
+BENCHMARK(BM_SearchBm25)->ArgNames({"terms", "high"})
+    ->Args({1, 1})->Args({1, 0})->Args({3, 1})->Args({10, 1});
+
+// ---- OR: документ за документом по куче курсоров с отсевом MaxScore ----
+static void BM_SearchAny(benchmark::State& state) {
+    run_search(state, SearchServer::Ranking::Count, SearchServer::Match::Any);
+}
+BENCHMARK(BM_SearchAny)->ArgNames({"terms", "high"})
+    ->Args({3, 1})->Args({3, 0})->Args({10, 1})->Args({10, 0});
+
+// ---- широкий OR (частые слова покрывают больше 10% корпуса): только куча
+// курсоров против плотного накопителя, по сумме вхождений и BM25;
+// matched_pct — доля документов корпуса в объединении листов (в среднем по запросам) ----
+static void run_search_wide(benchmark::State& state, float dense_fraction) {
+    auto& f = fixture();
+    const size_t terms = static_cast<size_t>(state.range(0));
+    double matched = 0;
+    for (size_t q = 0; q < 8; ++q) {
+        std::vector<bool> seen(f.docs.size());
+        for (size_t t = 0; t < terms; ++t)
+            for (const auto& e : f.index.GetWordCount(f.high(q * 7 + t))) seen[e.doc_id] = true;
+        matched += double(std::count(seen.begin(), seen.end(), true));
+    }
+    state.counters["matched_pct"] = 100.0 * matched / 8 / double(std::max<size_t>(f.docs.size(), 1));
+    const auto ranking = state.range(2) ? SearchServer::Ranking::Bm25 : SearchServer::Ranking::Count;
+    run_search(state, ranking, SearchServer::Match::Any, dense_fraction);
+}
+static void BM_SearchAnyWideCursors(benchmark::State& state) { run_search_wide(state, 2.0f); }
+static void BM_SearchAnyWideDense(benchmark::State& state) { run_search_wide(state, 0.0f); }
+BENCHMARK(BM_SearchAnyWideCursors)->ArgNames({"terms", "high", "bm25"})
+    ->Args({3, 1, 0})->Args({10, 1, 0})->Args({3, 1, 1})->Args({10, 1, 1});
+BENCHMARK(BM_SearchAnyWideDense)->ArgNames({"terms", "high", "bm25"})
+    ->Args({3, 1, 0})->Args({10, 1, 0})->Args({3, 1, 1})->Args({10, 1, 1});
+
+// ---- пересечение при перекосе частот: линейное слияние против галопа ----
+struct SkewFixture {
+    InvertedIndex index;
+    SkewFixture() {
+        const size_t n = env_or("SE_BENCH_SKEW_DOCS", 500000);
+        std::vector<std::string> docs(n);
+        for (size_t i = 0; i < n; ++i) {
+            if (i % 20 != 0) docs[i] += "common ";
+            for (size_t r = 0, every = 10; r < 4; ++r, every *= 10)
+                if (i % every == 0) docs[i] += "rare" + std::string(1, char('a' + r)) + " ";
+        }
+        index.UpdateDocumentBase(docs);
+    }
+};
+
+static SkewFixture& skew() {
+    static SkewFixture f;
+    return f;
+}
+
+static void BM_IntersectLinear(benchmark::State& state) {
+    const std::string rare = "rare" + std::string(1, char('a' + state.range(0)));
+    for (auto _ : state) {
+        PostingCursor a = skew().index.GetPostings(rare);
+        PostingCursor b = skew().index.GetPostings("common");
+        size_t sum = 0;
+        while (!a.at_end() && !b.at_end()) {
+            if (a.doc() == b.doc()) { sum += a.count() + b.count(); a.next(); b.next(); }
+            else if (a.doc() < b.doc()) a.next();
+            else b.next();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+BENCHMARK(BM_IntersectLinear)->ArgName("rare")->DenseRange(0, 3)->Unit(benchmark::kMicrosecond);
+
+static void BM_IntersectGallop(benchmark::State& state) {
+    const std::string rare = "rare" + std::string(1, char('a' + state.range(0)));
+    for (auto _ : state) {
+        PostingCursor a = skew().index.GetPostings(rare);
+        PostingCursor b = skew().index.GetPostings("common");
+        size_t sum = 0;
+        while (!a.at_end()) {
+            if (!b.advance_to(a.doc())) break;
+            if (b.doc() == a.doc()) { sum += a.count() + b.count(); a.next(); }
+            else a.advance_to(b.doc());
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+BENCHMARK(BM_IntersectGallop)->ArgName("rare")->DenseRange(0, 3)->Unit(benchmark::kMicrosecond);
+
+// ---- кодировки posting-листов: размер и скорость распаковки ----
+// индекс общего корпуса в кодировке codec (строится один раз на кодировку)
+static const InvertedIndex& codec_index(PostingCodec codec) {
+    static std::unique_ptr<InvertedIndex> built[3];
+    auto& idx = built[static_cast<size_t>(codec)];
+    if (!idx) {
+        idx = std::make_unique<InvertedIndex>();
+        idx->setPostingCodec(codec);
+        idx->UpdateDocumentBase(fixture().docs);
+    }
+    return *idx;
+}
+
+// Распаковка всех листов словаря поблочно (как их читают пересечение и подсчёт
+// релевантности). bytes_per_posting — байт блоков на posting, без таблиц
+// пропусков; items_per_second — распакованных postings в секунду.
+static void BM_DecodeCodec(benchmark::State& state) {
+    const auto codec = static_cast<PostingCodec>(state.range(0));
+    const CompactIndex& ci = codec_index(codec).Snapshot()->segments.front().segment->index;
+    size_t postings = 0, bytes = 0;
+    uint64_t sum = 0;
+    for (auto _ : state) {
+        postings = bytes = 0;
+        for (size_t t = 0; t < ci.term_count(); ++t) {
+            PostingCursor c = ci.cursor(t);
+            if (c.at_end()) continue;
+            do {
+                const uint32_t* docs = c.block_docs();
+                const uint32_t* counts = c.block_counts();
+                for (uint32_t i = 0; i < c.block_len(); ++i) sum += docs[i] + counts[i];
+            } while (c.next_block());
+            postings += c.size();
+            bytes += c.bytes_read();
+        }
+    }
+    benchmark::DoNotOptimize(sum);
+    state.counters["bytes_per_posting"] = double(bytes) / double(std::max<size_t>(postings, 1));
+    state.counters["index_mb"] = double(codec_index(codec).MemoryUsage()) / (1024.0 * 1024.0);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * postings));
+}
+BENCHMARK(BM_DecodeCodec)->ArgName("codec")->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+// те же запросы AND по частым словам на индексах в разных кодировках
+static void BM_SearchCodec(benchmark::State& state) {
+    const auto& idx = codec_index(static_cast<PostingCodec>(state.range(2)));
+    run_search(state, SearchServer::Ranking::Count, SearchServer::Match::All, 0.1f, &idx);
+}
+BENCHMARK(BM_SearchCodec)->ArgNames({"terms", "high", "codec"})
+    ->Args({1, 1, 0})->Args({1, 1, 1})->Args({1, 1, 2})->Args({3, 1, 0})->Args({3, 1, 1})->Args({3, 1, 2});
+
+BENCHMARK_MAIN();
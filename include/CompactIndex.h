@@ -0,0 +1,112 @@
+#pragma once
+#include "PostingCursor.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Entry;
+class ThreadPool;
+
+// Замороженный (только для чтения) индекс с плотной раскладкой в памяти:
+//  - все слова лежат подряд в одной строке-арене, словарь отсортирован;
+//  - posting-листы — один байтовый массив: doc_id и count блоками по
+//    PostingCursor::BLOCK в выбранной кодировке (PostingCodec, по умолчанию
+//    varint-дельты); у длинных листов впереди таблица пропусков;
+//  - позиции вхождений (необязательно) — отдельной секцией в конце образа,
+//    формат описан у PositionReader.
+// Строится один раз после фазы индексации, дальше только читается.
+// Всё хранится одним непрерывным образом без указателей: его можно записать
+// в файл как есть и потом работать прямо с отображённой в память копией.
+class CompactIndex {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    // слово и его posting-лист, отсортированный по doc_id; positions — позиции
+    // вхождений подряд, postings[i].count штук на запись (nullptr — без позиций)
+    struct TermPostings {
+        std::string_view term;
+        const std::vector<Entry>* postings = nullptr;
+        const std::vector<uint32_t>* positions = nullptr;
+    };
+
+    CompactIndex() = default;
+    // секции указывают внутрь образа, поэтому только перемещение
+    CompactIndex(const CompactIndex&) = delete;
+    CompactIndex& operator=(const CompactIndex&) = delete;
+    CompactIndex(CompactIndex&&) noexcept = default;
+    CompactIndex& operator=(CompactIndex&&) noexcept = default;
+
+    // terms могут идти в любом порядке; pool (если задан) кодирует листы параллельно.
+    // Позиции сохраняются, только если они заданы у всех слов.
+    void build(std::vector<TermPostings> terms, ThreadPool* pool = nullptr,
+               PostingCodec codec = PostingCodec::Varint);
+    void clear();
+
+    // подключить готовый образ без копирования; owner держит его память живой.
+    // Бросает std::runtime_error, если образ не проходит проверку структуры.
+    void attach(const uint8_t* image, size_t size, std::shared_ptr<const void> owner);
+
+    const uint8_t* image() const { return image_; }
+    size_t image_size() const { return image_size_; }
+
+    size_t term_count() const { return terms_; }
+
+    // кодировка posting-листов образа
+    PostingCodec codec() const { return codec_; }
+
+    // номер слова в словаре или npos
+    size_t find(std::string_view word) const;
+
+    std::string_view term(size_t t) const {
+        return { arena_ + term_offsets_[t], term_offsets_[t + 1] - term_offsets_[t] };
+    }
+
+    // число документов, где встречается слово
+    size_t doc_freq(size_t t) const { return doc_freq_[t]; }
+
+    // максимум count по листу слова
+    uint32_t max_count(size_t t) const { return max_count_[t]; }
+
+    // курсор по posting-листу слова (данные не копируются)
+    PostingCursor cursor(size_t t) const {
+        return PostingCursor(postings_ + post_offsets_[t], doc_freq_[t], max_count_[t], codec_);
+    }
+
+    // есть ли в индексе позиции вхождений
+    bool has_positions() const { return pos_offsets_ != nullptr; }
+
+    // позиции вхождений слова (пустой читатель, если индекс без позиций)
+    PositionReader positions(size_t t) const {
+        if (!pos_offsets_) return {};
+        return PositionReader(positions_ + pos_offsets_[t], doc_freq_[t]);
+    }
+
+    // распаковать posting-лист слова (добавляется в конец out)
+    void decode(size_t t, std::vector<Entry>& out) const;
+
+    // байт, занятых структурами индекса
+    size_t memory_usage() const;
+
+private:
+    void bind(const uint8_t* image, size_t size);
+
+    std::vector<uint64_t> storage_;       // собственный образ (после build), выровнен на 8
+    std::shared_ptr<const void> owner_;   // владелец внешнего образа (например, MappedFile)
+    const uint8_t* image_ = nullptr;
+    size_t image_size_ = 0;
+
+    // секции образа
+    size_t terms_ = 0;
+    PostingCodec codec_ = PostingCodec::Varint;
+    const char* arena_ = nullptr;              // слова подряд, в порядке словаря
+    const uint32_t* term_offsets_ = nullptr;   // terms_ + 1 смещений в arena_
+    const uint64_t* post_offsets_ = nullptr;   // terms_ + 1 смещений в postings_
+    const uint32_t* doc_freq_ = nullptr;
+    const uint32_t* max_count_ = nullptr;      // максимум count по листу (верхняя оценка)
+    const uint8_t* postings_ = nullptr;
+    const uint64_t* pos_offsets_ = nullptr;    // terms_ + 1 смещений в positions_ (nullptr — без позиций)
+    const uint8_t* positions_ = nullptr;
+};
@@ -1,7 +1,13 @@
 #pragma once
+#include <nlohmann/json_fwd.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+// config.json и requests.json разбираются один раз и кэшируются до смены
+// каталога ресурсов; answers.json пишется потоково (JsonWriter), без DOM.
 class ConverterJSON {
 public:
     ConverterJSON() = default;
@@ -12,15 +18,85 @@ public:
     // документы из config.json["files"]
     std::vector<std::string> GetTextDocuments();
 
+    // пути к документам из config.json["files"] без чтения самих файлов
+    // (отсутствующие пропускаются с сообщением, как в GetTextDocuments)
+    std::vector<std::string> GetTextDocumentPaths();
+
     // лимит ответов (если нет — 5)
     int GetResponsesLimit();
 
+    // число потоков индексации (config.index_threads; 0 или нет — по числу ядер)
+    size_t GetIndexThreads();
+
+    // число потоков обработки пакета запросов (config.search_threads; 0 или нет — по числу ядер)
+    size_t GetSearchThreads();
+
+    // число шардов индекса в этом процессе (config.shards; по умолчанию 1 — без разбиения)
+    size_t GetShardCount();
+
+    // адреса процессов-шардов (config.shard_addresses: ["unix:PATH" | "tcp:PORT", ...]);
+    // если заданы, пакет запросов раздаётся им, а локальный индекс не строится
+    std::vector<std::string> GetShardAddresses();
+
+    // бюджет кэша результатов в байтах (config.cache_mb; 0 или нет — кэш выключен)
+    size_t GetCacheBytes();
+
+    // функция ранжирования (config.ranking: "count" | "tfidf" | "bm25"; по умолчанию "count")
+    std::string GetRanking();
+
+    // режим сопоставления слов запроса (config.match: "all" | "any" | "phrase"; по умолчанию "all")
+    std::string GetMatch();
+
+    // сколько разных слов запроса должно найтись в документе в режиме "any"
+    // (config.min_should_match; 0 или нет — 1)
+    size_t GetMinShouldMatch();
+
+    // Ограничения ТЗ (0 — без ограничения). Слов в документе — config.max_doc_words
+    // (по умолчанию 1000), запросов — config.max_requests (1000), слов в запросе —
+    // config.max_query_words (10).
+    size_t GetMaxDocWords();
+    size_t GetMaxRequests();
+    size_t GetMaxQueryWords();
+
+    // по сколько запросов обрабатывать requests.json в ProcessRequests
+    // (config.request_batch; 0 или нет — 1000)
+    size_t GetRequestBatch();
+
+    // хранить ли в индексе позиции слов для фразовых запросов (config.positions; по умолчанию да)
+    bool GetStorePositions();
+
+    // кодировка posting-листов (config.codec: "raw" | "varint" | "bitpack"; по умолчанию "varint")
+    std::string GetPostingCodec();
+
+    // путь к файлу сохранённого индекса (config.index_file, по умолчанию resources/index.bin)
+    std::string GetIndexFile();
+
+    // отпечаток конфигурации: версия, список файлов, их размеры и время изменения.
+    // Если он совпадает с записанным в файле индекса — индекс можно не перестраивать.
+    uint64_t GetConfigFingerprint();
+
     // список запросов из requests.json
     std::vector<std::string> GetRequests();
 
     // ответы в answers.json
     void putAnswers(const std::vector<std::vector<std::pair<int, float>>>& answers);
 
+    using Answers = std::vector<std::vector<std::pair<int, float>>>;
+    using BatchHandler = std::function<Answers(const std::vector<std::string>&)>;
+
+    // requests.json -> answers.json потоком: запросы читаются SAX-разбором
+    // пачками по batch_size (0 — 1), handler отвечает на пачку, ответы сразу
+    // дописываются в answers.json. В памяти не больше одной пачки запросов и
+    // ответов. Учитываются первые max_requests запросов (0 — все). Ключи ответов —
+    // в порядке запросов: до 999 запросов файл совпадает с putAnswers побайтно,
+    // дальше request1000 идёт за request999, а не за request100.
+    // Возвращает число обработанных запросов.
+    size_t ProcessRequests(size_t batch_size, size_t max_requests, const BatchHandler& handler);
+
 private:
+    const nlohmann::json& config();   // разобранный и проверенный config.json
+
     std::string resources_dir_ = "resources";
+    std::shared_ptr<const nlohmann::json> config_;
+    std::shared_ptr<const std::vector<std::string>> requests_;
 };
@@ -1,6 +1,12 @@
 #pragma once
-#include <map>
+#include "CompactIndex.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 
@@ -13,15 +19,172 @@ struct Entry {
     }
 };
 
+// Неизменяемый сегмент индекса: замороженный словарь, отсортированный список
+// doc_id, которые в нём проиндексированы, и длины этих документов (в словах,
+// для ранжирования BM25). doc_id в posting-листах — глобальные.
+struct Segment {
+    CompactIndex index;
+    std::vector<uint32_t> docs;
+    std::vector<uint32_t> lengths; // lengths[i] — длина docs[i]
+
+    size_t min_doc() const { return docs.front(); }
+    bool contains(size_t doc) const;
+
+    // индекс документа в docs (документ должен быть в сегменте)
+    size_t position(size_t doc) const;
+    uint32_t length(size_t doc) const { return lengths[position(doc)]; }
+};
+
+// Сегмент в составе снимка вместе с его удалёнными документами (tombstones).
+// Битовая карта индексируется (doc_id - min_doc) и копируется при каждом удалении.
+struct SegmentView {
+    std::shared_ptr<const Segment> segment;
+    std::shared_ptr<const std::vector<uint64_t>> deleted; // nullptr — удалений нет
+    size_t deleted_count = 0;
+
+    bool is_deleted(size_t doc) const {
+        if (!deleted) return false;
+        const size_t i = doc - segment->min_doc();
+        return ((*deleted)[i >> 6] >> (i & 63)) & 1;
+    }
+};
+
+// Согласованное состояние индекса на момент времени. Каждый живой документ
+// принадлежит ровно одному сегменту, где он не помечен удалённым.
+struct IndexSnapshot {
+    std::vector<SegmentView> segments;
+    size_t doc_count = 0;     // живых документов
+    size_t next_doc_id = 0;   // id для следующего AddDocument
+    uint64_t generation = 0;  // растёт при каждом изменении, влияющем на результаты поиска
+    uint64_t total_length = 0; // сумма длин живых документов (средняя длина для BM25)
+};
+
+// Индекс — набор сегментов в духе LSM: UpdateDocumentBase строит базовый
+// сегмент, AddDocument/ReplaceDocument добавляют маленькие сегменты,
+// RemoveDocument ставит tombstone. Когда сегментов становится много, фоновый
+// поток сливает их в один, выбрасывая удалённые документы.
+//
+// Потокобезопасность: изменения сериализуются внутренним мьютексом и
+// публикуют новый снимок атомарно. Читатели (Snapshot, GetWordCount и
+// SearchServer) работают со своим снимком и видят его целиком, не блокируясь
+// записью; снимок держит свои сегменты живыми. Исключение — GetPostings:
+// его курсор действителен только до следующего изменения индекса.
 class InvertedIndex {
 public:
     InvertedIndex() = default;
+    ~InvertedIndex();
+
+    InvertedIndex(const InvertedIndex&) = delete;
+    InvertedIndex& operator=(const InvertedIndex&) = delete;
+
+    // число потоков индексации (0 — по числу ядер)
+    void setThreadCount(size_t threads) { threads_ = threads; }
+
+    static constexpr size_t MAX_DOC_WORDS = 1000; // ограничение ТЗ по умолчанию
+
+    // Сколько первых слов документа индексировать (по умолчанию MAX_DOC_WORDS;
+    // 0 — без ограничения). Без ограничения большой документ (от мегабайта)
+    // при полной перестройке разбирается по частям параллельно.
+    void setMaxDocWords(size_t words) { max_doc_words_ = words; }
+    size_t maxDocWords() const { return max_doc_words_; }
+
+    // Хранить ли позиции вхождений слов (по умолчанию да) — нужны только фразовым
+    // запросам. Действует на последующие построения и добавления документов.
+    void setStorePositions(bool store) { store_positions_ = store; }
+
+    // Кодировка posting-листов (PostingCodec): Raw — быстрее всего читается, но
+    // 8 байт на posting; Varint (по умолчанию) — компактно; BitPack — почти так же
+    // компактно и распаковывается SIMD. Действует на последующие построения,
+    // добавления и слияния; загруженный файл индекса сохраняет свою кодировку.
+    void setPostingCodec(PostingCodec codec) { codec_ = codec; }
+    PostingCodec postingCodec() const { return codec_; }
+    // "raw" | "varint" | "bitpack"; иначе std::runtime_error
+    static PostingCodec parsePostingCodec(const std::string& name);
+
+    // хранить ли копию исходных текстов базового набора (по умолчанию нет)
+    void setKeepDocuments(bool keep) { keep_documents_ = keep; }
 
+    // тексты базового набора, если включено setKeepDocuments(true)
+    const std::vector<std::string>& Documents() const { return docs_; }
+
+    // полная перестройка: документы получают id 0..n-1
     void UpdateDocumentBase(const std::vector<std::string>& input_docs);
 
-    std::vector<Entry> GetWordCount(const std::string& word);
+    // Полная перестройка потоком из файлов: каждый файл отображается в память
+    // (или читается, если отображение недоступно) и через очередь ограниченной
+    // длины уходит воркерам. Весь корпус в памяти не держится: пик — размер
+    // индекса плюс несколько документов в полёте. Документ i — это paths[i];
+    // нечитаемый файл индексируется как пустой документ.
+    void UpdateDocumentBaseFromFiles(const std::vector<std::string>& paths);
+
+    // добавить документ; возвращает его id. Стоимость — пропорциональна тексту.
+    size_t AddDocument(const std::string& text);
+
+    // пометить документ удалённым; false — такого живого документа нет
+    bool RemoveDocument(size_t doc_id);
+
+    // заменить текст документа, сохранив id; false — такого живого документа нет
+    bool ReplaceDocument(size_t doc_id, const std::string& text);
+
+    // слить все сегменты в один синхронно (дождавшись фонового слияния)
+    void MergeSegments();
+
+    // дождаться завершения фонового слияния, если оно идёт
+    void WaitForMerges();
+
+    // текущий согласованный снимок для чтения
+    std::shared_ptr<const IndexSnapshot> Snapshot() const;
+
+    // копия posting-листа слова по всем сегментам без удалённых документов
+    std::vector<Entry> GetWordCount(const std::string& word) const;
+
+    // курсор по posting-листу слова без копирования (пустой, если слова нет).
+    // Только для индекса из одного сегмента без удалений (иначе std::logic_error);
+    // в общем случае — Snapshot() и курсоры сегментов.
+    PostingCursor GetPostings(std::string_view word) const;
+
+    // байт, занятых замороженными сегментами
+    size_t MemoryUsage() const;
+
+    // поколение индекса: меняется при любом обновлении документов (но не при
+    // слиянии сегментов) — ключ инвалидации кэшей результатов
+    uint64_t Generation() const { return Snapshot()->generation; }
+
+    size_t DocumentCount() const { return Snapshot()->doc_count; }
+    size_t SegmentCount() const { return Snapshot()->segments.size(); }
+
+    // Сохранить индекс в версионированный бинарный файл (заголовок с контрольной
+    // суммой и отпечатком конфигурации + образ CompactIndex + список doc_id).
+    // Сегменты предварительно сливаются. Пишет через временный файл и
+    // переименование. Бросает std::runtime_error.
+    void SaveIndexFile(const std::string& path, uint64_t fingerprint);
+
+    // Отобразить файл индекса в память и работать прямо с ним, без разбора.
+    // false — файла нет, он устарел (другой отпечаток/версия) или повреждён;
+    // тогда индекс не меняется и его нужно перестроить.
+    bool LoadIndexFile(const std::string& path, uint64_t fingerprint, bool verify_checksum = true);
 
 private:
+    static constexpr size_t MAX_SEGMENTS = 8;   // больше — запускаем фоновое слияние
+
+    // same_results — снимок отвечает на запросы так же, как текущий (слияние без удалений)
+    void publish(std::shared_ptr<IndexSnapshot> snap, bool same_results = false);
+    void publish_base(std::shared_ptr<Segment> base, size_t n);
+    void maybe_start_merge();
+    void merge_tail(uint64_t epoch);
+
     std::vector<std::string> docs_;
-    std::map<std::string, std::vector<Entry>> freq_dictionary_;
+    bool keep_documents_ = false;
+    bool store_positions_ = true;
+    size_t max_doc_words_ = MAX_DOC_WORDS;
+    PostingCodec codec_ = PostingCodec::Varint;
+    size_t threads_ = 0;
+
+    std::shared_ptr<const IndexSnapshot> snapshot_ = std::make_shared<IndexSnapshot>(); // через atomic_load/store
+    std::mutex write_mutex_;      // сериализует изменения
+    uint64_t epoch_ = 0;          // меняется при полной перестройке/загрузке
+    uint64_t generation_ = 0;     // последнее выданное поколение снимка
+    std::mutex merge_mutex_;      // охраняет merge_thread_
+    std::thread merge_thread_;
+    std::atomic<bool> merging_{false};
 };
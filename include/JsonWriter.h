@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Потоковая запись JSON без построения DOM: каждое событие (начало объекта,
+// ключ, значение...) сразу дописывается в буфер, а буфер порциями уходит в
+// поток. Оформление повторяет nlohmann::json::dump(indent): при том же порядке
+// ключей (nlohmann сортирует их) вывод совпадает побайтно, вплоть до записи
+// чисел с плавающей точкой.
+//
+// Корректность вложенности не проверяется: ключ — только внутри объекта,
+// перед каждым значением объекта — ключ.
+class JsonWriter {
+public:
+    // indent < 0 — компактно, иначе с переводами строк и отступом indent пробелов
+    explicit JsonWriter(std::ostream& out, int indent = -1);
+    ~JsonWriter();
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(std::string_view k);
+
+    void value(std::string_view s);
+    void value(const char* s) { value(std::string_view(s)); }
+    void value(int64_t v);
+    void value(int v) { value(static_cast<int64_t>(v)); }
+    void value(uint64_t v);
+    void value(double v);   // не конечные — null, как у nlohmann
+    void value(bool v);
+    void null();
+
+    // отдать накопленное в поток
+    void flush();
+
+private:
+    static constexpr size_t FLUSH_AT = 64 * 1024;
+
+    void before_value();
+    void open(char c);
+    void close(char c);
+    void newline(size_t depth);
+    void put_string(std::string_view s);
+
+    std::ostream& out_;
+    int indent_;
+    std::string buf_;
+    std::vector<size_t> counts_;   // элементов в каждом открытом контейнере
+    bool after_key_ = false;
+};
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Метрики горячего пути: счётчики и гистограммы (логарифмические корзины по
+// степеням двойки). Каждый поток пишет в свой слот без блокировок и атомарных
+// RMW; слоты складываются только при снятии снимка (toJson/toPrometheus).
+//
+// В коде индекса и поиска метрики пишутся через макросы SE_METRIC_*: при
+// сборке с -DSEARCH_ENGINE_METRICS=OFF они раскрываются в пустоту и не
+// вычисляют аргументы, а экспорт отдаёт нули.
+class Metrics {
+public:
+    enum class Counter : uint32_t {
+        IndexDocuments,         // проиндексировано документов
+        IndexDocsTruncated,     // документов, обрезанных по MAX_DOC_WORDS
+        SearchQueries,          // обработано запросов
+        SearchQueriesTruncated, // запросов, обрезанных по MAX_QUERY_WORDS
+        SearchCacheHits,        // запросов, отданных из кэша результатов
+        SearchPostings,         // длин posting-листов, затронутых запросами (сумма)
+        SearchBytesRead,        // байт posting-листов, декодированных запросами
+        SearchDenseSegments,    // сегментов, где OR считался плотным накопителем
+        COUNT
+    };
+
+    enum class Histogram : uint32_t {
+        IndexBuildNs,           // UpdateDocumentBase целиком
+        IndexTokenizeNs,        // токенизация и подсчёт слов (на документ)
+        IndexMergeNs,           // слияние частичных индексов (на шард)
+        IndexSortNs,            // сортировка словаря и кодирование листов
+        SearchQueryNs,          // запрос целиком
+        SearchLookupNs,         // поиск слов в словарях сегментов
+        SearchIntersectNs,      // пересечение листов вместе с подсчётом релевантности
+        SearchTopKNs,           // сортировка отобранных (без нормализации)
+        SearchPostingsPerQuery, // суммарная длина листов слов запроса
+        SearchBytesPerQuery,    // декодировано байт листов за запрос
+        COUNT
+    };
+
+    static void add(Counter c, uint64_t v);
+    static void observe(Histogram h, uint64_t v);
+
+    static uint64_t now_ns();
+
+    // замер времени области видимости в гистограмму
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Histogram h) : h_(h), start_(now_ns()) {}
+        ~ScopedTimer() { observe(h_, now_ns() - start_); }
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+    private:
+        Histogram h_;
+        uint64_t start_;
+    };
+
+    static bool enabled();
+
+    // обнулить (вычитанием из снимков; потоки-писатели не затрагиваются)
+    static void reset();
+
+    static std::string toJson();
+    static std::string toPrometheus();
+};
+
+#if SEARCH_ENGINE_METRICS
+#define SE_METRIC_ADD(c, v)     ::Metrics::add(::Metrics::Counter::c, (v))
+#define SE_METRIC_OBSERVE(h, v) ::Metrics::observe(::Metrics::Histogram::h, (v))
+#define SE_METRIC_TIMER(h)      ::Metrics::ScopedTimer se_metric_timer_##h(::Metrics::Histogram::h)
+#define SE_METRIC_NOW()         ::Metrics::now_ns()
+#else
+#define SE_METRIC_ADD(c, v)     ((void)0)
+#define SE_METRIC_OBSERVE(h, v) ((void)0)
+#define SE_METRIC_TIMER(h)      ((void)0)
+#define SE_METRIC_NOW()         uint64_t(0)
+#endif
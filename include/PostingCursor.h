@@ -0,0 +1,138 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Кодирование блоков posting-листа (выбирается на индекс, см. PostingCursor):
+//   Raw     — без сжатия: BLOCK u32 doc_id, затем BLOCK u32 count;
+//   Varint  — пары varint (дельта doc_id, count) — по умолчанию;
+//   BitPack — полный блок упакован по битам, как SIMD-BP128: байт ширины дельт bd
+//             и байт ширины (count - 1) bc, затем 16 * bd байт дельт и 16 * bc байт
+//             count; значение i лежит в дорожке i % 4 128-битных слов, так что
+//             блок распаковывается сдвигами и масками SSE2 по четыре значения.
+//             Неполный последний блок — как в Varint (паковать его невыгодно).
+enum class PostingCodec : uint8_t { Raw, Varint, BitPack };
+
+// Курсор по posting-листу без копирования: читает прямо из буфера индекса,
+// ничего не выделяя. Листы отсортированы по doc_id.
+//
+// Формат листа из size postings:
+//   [таблица пропусков, если блоков > 1] [блок 0] [блок 1] ...
+// Блок — до BLOCK postings в кодировке индекса; дельты doc_id считаются от
+// последнего doc_id предыдущего блока, поэтому блоки декодируются независимо.
+// Блок декодируется целиком в docs/counts курсора, и пересечение с подсчётом
+// релевантности работают прямо с ними.
+// Запись таблицы пропусков на блок: last_doc, конец блока (байт от начала
+// блоков) и максимальный count в блоке — по u32. advance_to ищет блок галопом
+// по таблице и не трогает байты пропущенных блоков; максимумы блоков дают
+// верхние оценки релевантности для досрочного отсева (block-max).
+class PostingCursor {
+public:
+    static constexpr uint32_t BLOCK = 128;
+    static constexpr size_t SKIP_ENTRY = 12;
+
+    PostingCursor() = default;
+    PostingCursor(const uint8_t* data, uint32_t size, uint32_t max_count,
+                  PostingCodec codec = PostingCodec::Varint);
+
+    size_t size() const { return size_; }       // длина листа (в скольких документах слово)
+    bool at_end() const { return end_; }
+    size_t doc() const { return docs_[pos_]; }
+    size_t count() const { return counts_[pos_]; }
+    uint32_t max_count() const { return max_count_; } // максимум count по всему листу
+    size_t bytes_read() const { return bytes_read_; }  // декодировано байт блоков (для метрик)
+
+    // к следующему posting; false — лист закончился
+    bool next() {
+        if (++pos_ < len_) return true;
+        if (block_ + 1 < nblocks_) { load_block(block_ + 1); return true; }
+        pos_ = len_ - 1;
+        end_ = true;
+        return false;
+    }
+
+    // к первому posting с doc_id >= target; false — такого нет
+    bool advance_to(size_t target) {
+        if (end_) return false;
+        if (docs_[pos_] >= target) return true;
+        return seek(target);
+    }
+
+    // Поверхностный просмотр без декодирования: номер первого блока (не раньше
+    // текущего), чей last_doc >= target, или block_count(), если такого нет.
+    uint32_t find_block(size_t target) const;
+    uint32_t block_count() const { return nblocks_; }
+    size_t block_last_doc(uint32_t b) const { return nblocks_ > 1 ? skip_field(b, 0) : last_doc_; }
+    uint32_t block_max(uint32_t b) const { return nblocks_ > 1 ? skip_field(b, 2) : max_count_; }
+
+    // Поблочный проход: декодированный текущий блок целиком (для векторной
+    // обработки) и переход к началу следующего; false — блоков больше нет.
+    uint32_t block() const { return block_; }
+    uint32_t block_len() const { return len_; }
+    uint32_t block_pos() const { return pos_; }
+    const uint32_t* block_docs() const { return docs_; }
+    const uint32_t* block_counts() const { return counts_; }
+    bool next_block() {
+        if (end_) return false;
+        if (block_ + 1 < nblocks_) { load_block(block_ + 1); return true; }
+        pos_ = len_ - 1;
+        end_ = true;
+        return false;
+    }
+    // к началу блока b (не раньше текущего), не декодируя пропущенные
+    bool skip_to_block(uint32_t b) {
+        if (end_) return false;
+        if (b == block_) return true;
+        if (b < nblocks_) { load_block(b); return true; }
+        pos_ = len_ - 1;
+        end_ = true;
+        return false;
+    }
+
+private:
+    bool seek(size_t target);
+    void load_block(uint32_t b);
+    uint32_t skip_field(uint32_t b, uint32_t f) const;
+
+    const uint8_t* skips_ = nullptr;   // таблица пропусков (nullptr у одноблочных листов)
+    const uint8_t* blocks_ = nullptr;  // начало закодированных блоков
+    uint32_t size_ = 0;
+    uint32_t nblocks_ = 0;
+    uint32_t max_count_ = 0;
+    PostingCodec codec_ = PostingCodec::Varint;
+    uint32_t last_doc_ = 0;            // последний doc_id одноблочного листа
+    uint32_t block_ = 0;               // текущий декодированный блок
+    uint32_t len_ = 0;                 // postings в текущем блоке
+    uint32_t pos_ = 0;                 // позиция в текущем блоке
+    bool end_ = true;
+    size_t bytes_read_ = 0;
+    uint32_t docs_[BLOCK] = {};
+    uint32_t counts_[BLOCK] = {};
+};
+
+// Позиции вхождений слова (номера слов в документе), для фразовых запросов.
+// Лежат отдельно от posting-листов, в конце образа индекса, поэтому запросы
+// без фраз их не читают, а у отображённого файла эти страницы даже не подгружаются.
+//
+// Формат для листа из size postings:
+//   [смещения блоков, если блоков > 1] [позиции posting 0] [позиции posting 1] ...
+// Смещение блока — u32 от начала позиций, по одному на блок PostingCursor.
+// Позиции posting — count значений varint: дельты от предыдущей (первая от нуля).
+class PositionReader {
+public:
+    PositionReader() = default;
+    PositionReader(const uint8_t* data, uint32_t size);
+
+    bool empty() const { return data_ == nullptr; }
+
+    // позиции текущего posting курсора c того же слова — в out (заменяя), по возрастанию.
+    // Курсор между вызовами может только продвигаться вперёд; каждый posting — не больше раза.
+    void read(const PostingCursor& c, std::vector<uint32_t>& out);
+
+private:
+    const uint8_t* table_ = nullptr;  // смещения блоков (nullptr у одноблочных листов)
+    const uint8_t* data_ = nullptr;   // начало позиций
+    const uint8_t* p_ = nullptr;      // позиции posting (block_, pos_)
+    uint32_t block_ = 0;
+    uint32_t pos_ = 0;
+};
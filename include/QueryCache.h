@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct RelativeIndex;
+
+// Кэш результатов запросов: LRU, разбитый на шарды по хешу ключа, чтобы
+// параллельные запросы не упирались в один мьютекс. Запись помнит поколение
+// индекса, на котором посчитана; при другом поколении она считается промахом
+// и вытесняется. Размер ограничен бюджетом в байтах (делится между шардами).
+class QueryCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    // capacity_bytes == 0 — кэш выключен
+    explicit QueryCache(size_t capacity_bytes = 0);
+
+    // не вызывать одновременно с get/put
+    void setCapacity(size_t capacity_bytes);
+    bool enabled() const { return capacity_ > 0; }
+
+    // true и результат в out, если есть запись этого поколения
+    bool get(const std::string& key, uint64_t generation, std::vector<RelativeIndex>& out);
+    void put(const std::string& key, uint64_t generation, const std::vector<RelativeIndex>& value);
+
+    void clear();
+    Stats stats() const;
+
+private:
+    static constexpr size_t SHARDS = 16;
+
+    struct Item {
+        std::string key;
+        uint64_t generation;
+        std::vector<RelativeIndex> value;
+        size_t bytes;
+    };
+
+    struct Shard {
+        mutable std::mutex m;
+        std::list<Item> lru; // в начале — самые свежие
+        std::unordered_map<std::string, std::list<Item>::iterator> map;
+        size_t bytes = 0;
+    };
+
+    Shard& shard_of(const std::string& key);
+    void evict(Shard& s, size_t budget);
+
+    size_t capacity_ = 0;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<uint64_t> hits_{0}, misses_{0};
+};
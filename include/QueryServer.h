@@ -0,0 +1,105 @@
+#pragma once
+#include "SearchServer.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Долгоживущий режим: индекс строится/загружается один раз, дальше запросы
+// приходят по локальному сокету. Протокол — JSON по строке на сообщение:
+//   -> {"id": 7, "query": "milk water"}        (или просто "milk water")
+//   <- {"id": 7, "relevance": [{"docid": 0, "rank": 1.0}, ...], "latency_us": 42}
+//   -> {"query": "...", "raw": true, "limit": 10}  (абсолютная релевантность — для координатора шардов;
+//                                                  limit не больше 10000)
+//   -> {"query": "...", "query_stats": true}
+//   <- {"doc_count": N, "total_length": N, "df": [N, ...]}  (статистика корпуса для слов запроса)
+//   -> {"query": "...", "raw": true, "global_stats": {"doc_count": .., "total_length": .., "df": [..]}}
+//                                                 (веса слов по статистике всех шардов)
+//   -> {"cmd": "stats"}
+//   <- {"queries": N, "errors": N, "latency_us": {"p50": .., "p99": .., "max": ..},
+//       "cache": {"hits": N, "misses": N}}
+//   -> {"cmd": "metrics"}                         (Metrics::toJson)
+//   -> {"cmd": "metrics", "format": "prometheus"} ({"prometheus": "<текст>"})
+// Ошибочный запрос получает {"id": .., "error": "..."}. Ответы в пределах
+// соединения идут в порядке запросов, даже если воркеры закончили вразнобой.
+//
+// Сетевой ввод-вывод — один поток с epoll (неблокирующие сокеты), поиск —
+// в пуле воркеров; готовые ответы возвращаются в цикл через eventfd.
+// Реализация только для Linux; на других платформах listen бросает исключение.
+class QueryServer {
+public:
+    // threads — воркеры поиска (0 — по числу ядер)
+    explicit QueryServer(const SearchServer& search, size_t threads = 0);
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // адрес: "unix:/path/to.sock" или "tcp:PORT" (только 127.0.0.1).
+    // Бросает std::runtime_error, если сокет не открыть.
+    void listen(const std::string& address);
+
+    // сдвиг doc_id в ответах (процесс-шард отвечает глобальными номерами)
+    void setDocOffset(size_t offset) { doc_offset_ = offset; }
+
+    // цикл обработки; возвращается после stop()
+    void run();
+
+    // остановить run(); безопасно из другого потока и из обработчика сигнала
+    void stop();
+
+    // ответ на одну строку протокола (то же, что уходит клиенту, без '\n')
+    std::string handle(const std::string& line);
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string in, out;
+        uint64_t next_seq = 0;                  // номер следующего запроса
+        uint64_t send_seq = 0;                  // номер ответа, который отправляем следующим
+        std::map<uint64_t, std::string> ready;  // готовые ответы, ждущие своей очереди
+        uint32_t events = 0;                    // текущая подписка в epoll (0 — сокета в epoll нет)
+        bool eof = false;                       // клиент закрыл свою сторону
+    };
+
+    struct Completion {
+        uint64_t conn;
+        uint64_t seq;
+        std::string response;
+    };
+
+    void accept_all();
+    void read_from(uint64_t id);
+    void flush(uint64_t id);
+    void close_connection(uint64_t id);
+    void drain_completions();
+    void record_latency(uint32_t us, bool error);
+    std::string stats_json();
+
+    const SearchServer& search_;
+    size_t doc_offset_ = 0;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;            // eventfd: готовые ответы и stop()
+    std::string unix_path_;       // удаляется при закрытии
+    std::atomic<bool> stopping_{false};
+
+    std::unordered_map<uint64_t, Connection> conns_; // только поток цикла
+    uint64_t next_conn_id_ = 2;   // 0 — слушающий сокет, 1 — eventfd
+
+    std::mutex done_m_;
+    std::vector<Completion> done_;
+
+    std::mutex stats_m_;
+    uint64_t queries_ = 0, errors_ = 0;
+    uint32_t max_us_ = 0;
+    std::vector<uint32_t> recent_us_;  // кольцо последних задержек для перцентилей
+    size_t recent_pos_ = 0;
+
+    std::unique_ptr<ThreadPool> pool_; // сбрасывается первым в деструкторе: дожидается задач
+};
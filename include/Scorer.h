@@ -0,0 +1,74 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Статистика коллекции, из которой считаются веса слов запроса
+struct CollectionStats {
+    size_t doc_count = 0;    // живых документов
+    float avg_length = 0;    // средняя длина документа в словах
+};
+
+// Функции ранжирования. SearchServer выбирает одну на запрос, а внутренний
+// цикл по posting-листам инстанцируется шаблоном под каждую — без
+// виртуального вызова на posting. Интерфейс скорера:
+//   needs_length       — нужна ли длина документа (иначе в score приходит 0)
+//   Term term(stats, df)      — вес слова на запрос (df — в скольких документах слово)
+//   float score(term, count, length)  — вклад слова в документ
+//   float bound(term, max_count)      — оценка сверху score при count <= max_count
+//                                       и любой длине (для max-score/block-max)
+// Релевантность документа — сумма вкладов его слов; выдача нормализуется по максимуму.
+
+// Сумма вхождений слов — исходное ранжирование из ТЗ (по умолчанию)
+struct CountScorer {
+    static constexpr bool needs_length = false;
+    struct Term {};
+
+    Term term(const CollectionStats&, size_t) const { return {}; }
+    float score(const Term&, uint32_t count, uint32_t) const { return static_cast<float>(count); }
+    float bound(const Term&, uint32_t max_count) const { return static_cast<float>(max_count); }
+};
+
+// TF-IDF: (1 + ln tf) * ln(1 + N / df)
+struct TfIdfScorer {
+    static constexpr bool needs_length = false;
+    struct Term { float idf; };
+
+    Term term(const CollectionStats& st, size_t df) const {
+        return { static_cast<float>(std::log(1.0 + double(st.doc_count) / double(df ? df : 1))) };
+    }
+    float score(const Term& t, uint32_t count, uint32_t) const {
+        return (1.0f + std::log(static_cast<float>(count))) * t.idf;
+    }
+    // запас на округление: оценка не должна оказаться ниже точного значения
+    float bound(const Term& t, uint32_t max_count) const { return score(t, max_count, 0) * 1.0001f; }
+};
+
+// Okapi BM25: idf * tf * (k1 + 1) / (tf + k1 * (1 - b + b * len / avg_len))
+struct Bm25Scorer {
+    static constexpr bool needs_length = true;
+    float k1 = 1.2f;
+    float b = 0.75f;
+    struct Term {
+        float weight;   // idf * (k1 + 1)
+        float base;     // k1 * (1 - b)
+        float per_word; // k1 * b / avg_len
+    };
+
+    Term term(const CollectionStats& st, size_t df) const {
+        // df считается и по удалённым, но не слитым документам — может превысить N
+        const double f = double(df), n = std::max(double(st.doc_count), f);
+        // вариант idf без отрицательных значений для очень частых слов: вклады
+        // положительны, на этом держится отсев по оценкам сверху
+        const float idf = static_cast<float>(std::log(1.0 + (n - f + 0.5) / (f + 0.5)));
+        const float avg = st.avg_length > 0 ? st.avg_length : 1.0f;
+        return { idf * (k1 + 1), k1 * (1 - b), k1 * b / avg };
+    }
+    float score(const Term& t, uint32_t count, uint32_t length) const {
+        const float tf = static_cast<float>(count);
+        return t.weight * tf / (tf + t.base + t.per_word * static_cast<float>(length));
+    }
+    // максимум — при нулевой длине документа
+    float bound(const Term& t, uint32_t max_count) const { return score(t, max_count, 0) * 1.0001f; }
+};
@@ -1,5 +1,10 @@
 #pragma once
 #include "InvertedIndex.h"
+#include "QueryCache.h"
+#include "Scorer.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -12,17 +17,121 @@ struct RelativeIndex {
     }
 };
 
+// Статистика корпуса для слов запроса: живые документы, их суммарная длина
+// и df каждого уникального слова (в порядке первого появления в запросе).
+// Шардированный поиск складывает её по всем шардам, чтобы TF-IDF и BM25
+// взвешивали слова по всему корпусу, а не по своей части.
+struct QueryStats {
+    size_t doc_count = 0;
+    uint64_t total_length = 0;
+    std::vector<size_t> df;
+
+    QueryStats& operator+=(const QueryStats& other);
+};
+
 class SearchServer {
 public:
-    explicit SearchServer(InvertedIndex& idx, int responses_limit = 5)
+    explicit SearchServer(const InvertedIndex& idx, int responses_limit = 5)
         : index_(idx), responses_limit_(responses_limit) {}
 
     void setResponsesLimit(int limit) { responses_limit_ = (limit > 0 ? limit : 5); }
+    int responsesLimit() const { return responses_limit_; }
+
+    static constexpr size_t MAX_REQUESTS    = 1000; // запросов в пакете, остальные отбрасываются
+    static constexpr size_t MAX_QUERY_WORDS = 10;   // слов в запросе, остальные отбрасываются
+
+    // ограничения ТЗ можно сменить; 0 — без ограничения
+    void setMaxRequests(size_t n) { max_requests_ = n; }
+    size_t maxRequests() const { return max_requests_; }
+    void setMaxQueryWords(size_t n) { max_query_words_ = n; }
+    size_t maxQueryWords() const { return max_query_words_; }
+
+    // Функция ранжирования (Scorer.h). Count — сумма вхождений слов, как в ТЗ;
+    // TfIdf и Bm25 учитывают редкость слов, Bm25 ещё и длину документа.
+    enum class Ranking { Count, TfIdf, Bm25 };
+    void setRanking(Ranking r) { ranking_ = r; }
+    Ranking ranking() const { return ranking_; }
+    // "count" | "tfidf" | "bm25"; иначе std::runtime_error
+    static Ranking parseRanking(const std::string& name);
+
+    // Как слова запроса сопоставляются документу:
+    //   All    — документ содержит все слова (по умолчанию);
+    //   Any    — хотя бы min_should_match разных слов, релевантность — по найденным;
+    //   Phrase — все слова подряд в порядке запроса (нужен индекс с позициями,
+    //            иначе std::runtime_error).
+    // Запрос в двойных кавычках ("молоко с водой") — всегда фраза.
+    enum class Match { All, Any, Phrase };
+    void setMatch(Match m, size_t min_should_match = 1) {
+        match_ = m;
+        min_should_match_ = (min_should_match > 0 ? min_should_match : 1);
+    }
+    Match match() const { return match_; }
+    size_t minShouldMatch() const { return min_should_match_; }
+    // "all" | "any" | "phrase"; иначе std::runtime_error
+    static Match parseMatch(const std::string& name);
+
+    // OR-запрос, чьи листы в сумме покрывают не меньше этой доли диапазона doc_id
+    // сегмента, считается плотным массивом счетов вместо кучи курсоров
+    // (по умолчанию 0.1; 0 — всегда, больше 1 — только куча курсоров).
+    // Пути складывают счета в разном порядке, и ранги могут отличаться в
+    // последних битах, поэтому смена доли сбрасывает кэш результатов.
+    void setDenseFraction(float fraction) {
+        if (fraction != dense_fraction_) cache_.clear();
+        dense_fraction_ = fraction;
+    }
+    float denseFraction() const { return dense_fraction_; }
+
+    // сколько запросов пакета обрабатывать параллельно (0 — по числу ядер, 1 — последовательно)
+    void setThreadCount(size_t threads);
+
+    // Кэш результатов (байт; 0 — выключен, по умолчанию). Ключ — отсортированный
+    // набор уникальных слов запроса и лимит ответов; записи инвалидируются
+    // по поколению индекса, так что обновления документов видны сразу.
+    void setCacheCapacity(size_t bytes) { cache_.setCapacity(bytes); }
+    QueryCache::Stats cacheStats() const { return cache_.stats(); }
 
+    // Запросы независимы и читают индекс только через const-методы, поэтому
+    // пакет раскладывается по пулу потоков; порядок ответов совпадает с порядком запросов.
     std::vector<std::vector<RelativeIndex>>
     search(const std::vector<std::string>& queries_input);
 
+    // один запрос; const и потокобезопасен (читает согласованный снимок индекса)
+    std::vector<RelativeIndex> searchQuery(const std::string& query) const { return search_one(query); }
+
+    // Лучшие limit документов с абсолютной релевантностью в rank, без нормализации,
+    // в порядке (rank ↓, doc_id ↑). Нужен там, где результаты нескольких индексов
+    // сливаются и нормализуются по общему максимуму (шардированный поиск).
+    std::vector<RelativeIndex> searchRaw(const std::string& query, size_t limit) const {
+        return searchRaw(query, limit, match_, min_should_match_);
+    }
+    // то же с режимом сопоставления для этого запроса
+    // и, если задана, чужой статистикой корпуса (queryStats, сложенная по шардам)
+    std::vector<RelativeIndex> searchRaw(const std::string& query, size_t limit,
+                                         Match match, size_t min_should_match,
+                                         const QueryStats* stats = nullptr) const;
+    // То же в out (заменяя), переиспользуя его память. Рабочие буферы запроса
+    // у каждого потока свои и не отпускаются, так что при выключенном кэше
+    // повторные запросы не выделяют памяти вовсе.
+    void searchRaw(const std::string& query, size_t limit, Match match, size_t min_should_match,
+                   std::vector<RelativeIndex>& out, const QueryStats* stats = nullptr) const;
+
+    // статистика своего индекса для слов запроса (первый проход шардированного поиска)
+    QueryStats queryStats(const std::string& query) const;
+
+    // нормализация упорядоченной выдачи: rank /= rank первого
+    static void normalize(std::vector<RelativeIndex>& ranked);
+
 private:
-    InvertedIndex& index_; // ссылка на индекс
+    std::vector<RelativeIndex> search_one(const std::string& query) const;
+
+    const InvertedIndex& index_; // ссылка на индекс
     int responses_limit_ = 5;
+    Ranking ranking_ = Ranking::Count;
+    Match match_ = Match::All;
+    size_t min_should_match_ = 1;
+    float dense_fraction_ = 0.1f;
+    size_t max_requests_ = MAX_REQUESTS;
+    size_t max_query_words_ = MAX_QUERY_WORDS;
+    std::unique_ptr<ThreadPool> pool_; // nullptr — последовательный режим
+    mutable QueryCache cache_;
 };
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include "InvertedIndex.h"
+#include "SearchServer.h"
+#include <optional>
+#include <string>
+#include <vector>
+
+// Шард документного разбиения: отвечает на пакет запросов лучшими документами
+// своей части корпуса с абсолютной релевантностью (без нормализации) и с
+// глобальными doc_id. Координатор (ShardedSearchServer) сначала собирает со
+// всех шардов статистику корпуса для слов запросов, затем рассылает её сумму
+// вместе с запросами, сливает ответы и нормализует по общему максимуму.
+// Вызовы const и потокобезопасны.
+class SearchShard {
+public:
+    virtual ~SearchShard() = default;
+
+    // нужна ли шарду общая статистика (TF-IDF, BM25); для Count первый проход не делается
+    virtual bool needsStats() const = 0;
+
+    // статистика i — своей части корпуса для слов queries[i]
+    virtual std::vector<QueryStats> queryStats(const std::vector<std::string>& queries) const = 0;
+
+    // ответ i — для queries[i], в порядке (rank ↓, doc_id ↑), не длиннее limit;
+    // stats (если задана) — статистика всего корпуса, stats[i] для queries[i]
+    virtual std::vector<std::vector<RelativeIndex>>
+    searchRaw(const std::vector<std::string>& queries, size_t limit,
+              const std::vector<QueryStats>* stats = nullptr) const = 0;
+};
+
+// Шард в этом же процессе: свой InvertedIndex, doc_id которого сдвинуты на doc_offset.
+class LocalShard : public SearchShard {
+public:
+    explicit LocalShard(size_t doc_offset = 0) : doc_offset_(doc_offset) {}
+
+    InvertedIndex& index() { return index_; }
+    SearchServer& server() { return server_; }
+    size_t docOffset() const { return doc_offset_; }
+
+    bool needsStats() const override { return server_.ranking() != SearchServer::Ranking::Count; }
+    std::vector<QueryStats> queryStats(const std::vector<std::string>& queries) const override;
+    std::vector<std::vector<RelativeIndex>>
+    searchRaw(const std::vector<std::string>& queries, size_t limit,
+              const std::vector<QueryStats>* stats = nullptr) const override;
+
+private:
+    size_t doc_offset_;
+    InvertedIndex index_;
+    SearchServer server_{ index_ };
+};
+
+// Шард в отдельном процессе (app_search_engine --serve ADDR --shard S/N), с которым
+// говорим по протоколу QueryServer: пакет уходит одной пачкой по одному
+// соединению, ответы читаются в том же порядке. Ошибки — std::runtime_error.
+// Только Linux.
+class RemoteShard : public SearchShard {
+public:
+    // адрес в формате QueryServer::listen: "unix:PATH" или "tcp:PORT"; ranking —
+    // ранжирование процесса-шарда (не задано — статистика собирается всегда)
+    explicit RemoteShard(std::string address, std::optional<SearchServer::Ranking> ranking = std::nullopt)
+        : address_(std::move(address)), ranking_(ranking) {}
+
+    const std::string& address() const { return address_; }
+
+    bool needsStats() const override { return ranking_ != SearchServer::Ranking::Count; }
+    std::vector<QueryStats> queryStats(const std::vector<std::string>& queries) const override;
+    std::vector<std::vector<RelativeIndex>>
+    searchRaw(const std::vector<std::string>& queries, size_t limit,
+              const std::vector<QueryStats>* stats = nullptr) const override;
+
+private:
+    std::string address_;
+    std::optional<SearchServer::Ranking> ranking_;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include "SearchShard.h"
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Индекс, разбитый по документам на N независимых шардов (LocalShard).
+// Шард s получает непрерывный диапазон документов shard_range(n, N, s), поэтому
+// глобальный doc_id = начало диапазона + локальный id, и порядок doc_id внутри
+// шарда совпадает с глобальным. Шарды строятся параллельно.
+class ShardedIndex {
+public:
+    explicit ShardedIndex(size_t shards);
+
+    // общее число потоков индексации (делится между шардами; 0 — по числу ядер)
+    void setThreadCount(size_t threads) { threads_ = threads; }
+
+    // копирует в каждый шард его срез документов
+    void UpdateDocumentBase(const std::vector<std::string>& input_docs);
+    void UpdateDocumentBaseFromFiles(const std::vector<std::string>& paths);
+
+    size_t ShardCount() const { return shards_.size(); }
+    LocalShard& shard(size_t i) { return *shards_[i]; }
+    size_t DocumentCount() const;
+
+    // шарды для ShardedSearchServer
+    std::vector<const SearchShard*> shards() const;
+
+    // [begin, end) документов шарда s из shards при всего n документов
+    static std::pair<size_t, size_t> shard_range(size_t n, size_t shards, size_t s);
+
+private:
+    template <class Build>
+    void build(size_t n, Build&& build_shard);
+
+    std::vector<std::unique_ptr<LocalShard>> shards_;
+    size_t threads_ = 0;
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include "SearchServer.h"
+#include "SearchShard.h"
+#include "ThreadPool.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Координатор scatter-gather: пакет запросов рассылается всем шардам
+// параллельно, от каждого приходят лучшие responses_limit документов с
+// абсолютной релевантностью. Веса TF-IDF и BM25 шарды считают по общей
+// статистике корпуса (её собирает первый проход по шардам), поэтому ранги
+// сравнимы, глобальные top-N обязательно среди ответов, и слияние
+// (rank ↓, doc_id ↑) с нормализацией по общему максимуму дают ровно ту же
+// выдачу, что SearchServer над нешардированным индексом.
+class ShardedSearchServer {
+public:
+    // шарды не принадлежат серверу и должны его пережить
+    explicit ShardedSearchServer(std::vector<const SearchShard*> shards, int responses_limit = 5)
+        : shards_(std::move(shards)), responses_limit_(responses_limit) {}
+
+    void setResponsesLimit(int limit) { responses_limit_ = (limit > 0 ? limit : 5); }
+    // запросов в пакете (по умолчанию SearchServer::MAX_REQUESTS; 0 — без ограничения)
+    void setMaxRequests(size_t n) { max_requests_ = n; }
+
+    // параллельных заданий (шард × часть пакета); 0 — по числу ядер, 1 — последовательно
+    void setThreadCount(size_t threads);
+
+    std::vector<std::vector<RelativeIndex>>
+    search(const std::vector<std::string>& queries_input);
+
+private:
+    std::vector<const SearchShard*> shards_;
+    int responses_limit_ = 5;
+    size_t max_requests_ = SearchServer::MAX_REQUESTS;
+    std::unique_ptr<ThreadPool> pool_; // nullptr — последовательный режим
+};
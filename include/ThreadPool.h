@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков фиксированного размера с work-stealing:
+// у каждого воркера своя очередь, простаивающий воркер забирает задачи у соседей.
+class ThreadPool {
+public:
+    // threads == 0 — по числу аппаратных потоков
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    // поставить задачу в очередь (без ожидания)
+    void submit(std::function<void()> task);
+
+    // fn(i) для i из [0, n); блокирует до завершения всех итераций.
+    // Вызывающий поток тоже выполняет задачи, поэтому вызов изнутри воркера безопасен.
+    // Первое исключение из fn пробрасывается наружу.
+    void parallel_for(size_t n, const std::function<void(size_t)>& fn);
+
+    static size_t default_threads();
+
+private:
+    struct Queue {
+        std::mutex m;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void worker_loop(size_t id);
+    bool try_run_one(size_t home);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex wake_m_;
+    std::condition_variable wake_cv_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> next_queue_{0};
+    bool stop_ = false;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Общий токенизатор индексатора и запросов. Идёт по исходному буферу на месте
+// и отдаёт слова как string_view, ничего не выделяя.
+// Правила:
+//  - текст в UTF-8; слово — максимальная серия букв: латиница (ASCII, Latin-1,
+//    Latin Extended-A/B), кириллица (U+0400–U+052F) и комбинируемые знаки
+//    U+0300–U+036F; остальные символы и некорректные байты — разделители;
+//  - слово приводится к нижнему регистру (простое Unicode case folding;
+//    Ё → ё, а не е; ß остаётся ß);
+//  - слова длиннее max_word_len символов пропускаются.
+// Участки чистого ASCII проверяются SIMD-блоками по 32 байта и разбираются
+// по таблице без декодирования UTF-8.
+class Tokenizer {
+public:
+    static constexpr size_t MAX_WORD_LEN = 100;
+    // все буквы — не длиннее двух байт UTF-8, и в нижнем регистре не длиннее
+    static constexpr size_t MAX_WORD_BYTES = 2 * MAX_WORD_LEN;
+
+    explicit Tokenizer(std::string_view text, size_t max_word_len = MAX_WORD_LEN)
+        : text_(text), max_word_len_(max_word_len < MAX_WORD_LEN ? max_word_len : MAX_WORD_LEN) {}
+
+    // следующее слово; false — текст закончился.
+    // word указывает либо в исходный текст (stable() == true), либо во внутренний
+    // буфер токенизатора, если пришлось понижать регистр — тогда до следующего next().
+    bool next(std::string_view& word);
+
+    bool stable() const { return stable_; }
+
+private:
+    // слово с не-ASCII символами (или разделители вне ASCII) с позиции pos_
+    bool next_general(std::string_view& word);
+
+    std::string_view text_;
+    size_t pos_ = 0;
+    size_t ascii_end_ = 0;   // байты [pos_, ascii_end_) — заведомо ASCII
+    size_t max_word_len_;
+    bool stable_ = true;
+    char buf_[MAX_WORD_BYTES];
+};
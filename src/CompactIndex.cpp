@@ -0,0 +1,339 @@
+#include "CompactIndex.h"
+#include "InvertedIndex.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static size_t varint_size(uint32_t v) {
+    size_t n = 1;
+    while (v >= 0x80) { v >>= 7; ++n; }
+    return n;
+}
+
+static uint8_t* put_varint(uint8_t* p, uint32_t v) {
+    while (v >= 0x80) { *p++ = static_cast<uint8_t>(v | 0x80); v >>= 7; }
+    *p++ = static_cast<uint8_t>(v);
+    return p;
+}
+
+static uint32_t narrow(size_t v) {
+    if (v > UINT32_MAX) throw std::runtime_error("index value does not fit into 32 bits");
+    return static_cast<uint32_t>(v);
+}
+
+static void put_u32(uint8_t* p, uint32_t v) { std::memcpy(p, &v, sizeof(v)); }
+
+static size_t skip_table_size(size_t n) {
+    const size_t blocks = (n + PostingCursor::BLOCK - 1) / PostingCursor::BLOCK;
+    return blocks > 1 ? blocks * PostingCursor::SKIP_ENTRY : 0;
+}
+
+// сколько бит нужно для v
+static uint32_t bit_width(uint32_t v) {
+    uint32_t bits = 0;
+    while (v) { ++bits; v >>= 1; }
+    return bits;
+}
+
+// Упаковать BLOCK значений по bits бит в раскладку SIMD-BP128 (описана у
+// unpack_block в PostingCursor.cpp): значение i — в дорожке i % 4.
+static void pack_block(const uint32_t* v, uint32_t bits, uint8_t* out) {
+    std::memset(out, 0, 16 * size_t(bits));
+    for (uint32_t i = 0; i < PostingCursor::BLOCK; ++i) {
+        const uint32_t lane = i % 4, bit = (i / 4) * bits, word = bit / 32, off = bit % 32;
+        uint8_t* p = out + 16 * word + 4 * lane;
+        uint32_t w;
+        std::memcpy(&w, p, sizeof(w));
+        put_u32(p, w | (v[i] << off));
+        if (off + bits > 32) {
+            std::memcpy(&w, p + 16, sizeof(w));
+            put_u32(p + 16, w | (v[i] >> (32 - off)));
+        }
+    }
+}
+
+// Закодировать блок postings[begin, end) в out (prev — последний doc_id
+// предыдущего блока); out == nullptr — только посчитать размер. Возвращает байт.
+static size_t encode_block(const std::vector<Entry>& postings, size_t begin, size_t end, size_t prev,
+                           PostingCodec codec, uint8_t* out) {
+    const size_t n = end - begin;
+    switch (codec) {
+    case PostingCodec::Raw:
+        if (out) {
+            for (size_t i = 0; i < n; ++i) {
+                put_u32(out + 4 * i, narrow(postings[begin + i].doc_id));
+                put_u32(out + 4 * (n + i), narrow(postings[begin + i].count));
+            }
+        }
+        return n * 2 * sizeof(uint32_t);
+    case PostingCodec::BitPack:
+        if (n == PostingCursor::BLOCK) {
+            uint32_t deltas[PostingCursor::BLOCK], counts[PostingCursor::BLOCK];
+            uint32_t max_delta = 0, max_count = 0;
+            for (size_t i = 0; i < n; ++i) {
+                const Entry& e = postings[begin + i];
+                deltas[i] = narrow(e.doc_id - prev);
+                counts[i] = narrow(e.count - 1); // count >= 1
+                prev = e.doc_id;
+                max_delta = std::max(max_delta, deltas[i]);
+                max_count = std::max(max_count, counts[i]);
+            }
+            const uint32_t doc_bits = bit_width(max_delta), count_bits = bit_width(max_count);
+            if (out) {
+                out[0] = static_cast<uint8_t>(doc_bits);
+                out[1] = static_cast<uint8_t>(count_bits);
+                pack_block(deltas, doc_bits, out + 2);
+                pack_block(counts, count_bits, out + 2 + 16 * size_t(doc_bits));
+            }
+            return 2 + 16 * size_t(doc_bits + count_bits);
+        }
+        [[fallthrough]];
+    case PostingCodec::Varint: {
+        size_t bytes = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t delta = narrow(postings[i].doc_id - prev), count = narrow(postings[i].count);
+            if (out) out = put_varint(put_varint(out, delta), count);
+            bytes += varint_size(delta) + varint_size(count);
+            prev = postings[i].doc_id;
+        }
+        return bytes;
+    }
+    }
+    return 0;
+}
+
+static size_t encoded_size(const std::vector<Entry>& postings, PostingCodec codec) {
+    size_t bytes = skip_table_size(postings.size()), prev = 0;
+    for (size_t b = 0; b < postings.size(); b += PostingCursor::BLOCK) {
+        const size_t e = std::min(b + PostingCursor::BLOCK, postings.size());
+        bytes += encode_block(postings, b, e, prev, codec, nullptr);
+        prev = postings[e - 1].doc_id;
+    }
+    return bytes;
+}
+
+// формат описан в PostingCursor.h
+static void encode(const std::vector<Entry>& postings, PostingCodec codec, uint8_t* out) {
+    const size_t skip_bytes = skip_table_size(postings.size());
+    uint8_t* skip = out;
+    uint8_t* const blocks = out + skip_bytes;
+    uint8_t* p = blocks;
+    size_t prev = 0;
+    for (size_t b = 0; b < postings.size(); b += PostingCursor::BLOCK) {
+        const size_t e = std::min(b + PostingCursor::BLOCK, postings.size());
+        p += encode_block(postings, b, e, prev, codec, p);
+        prev = postings[e - 1].doc_id;
+        if (skip_bytes) {
+            size_t block_max = 0;
+            for (size_t i = b; i < e; ++i) block_max = std::max(block_max, postings[i].count);
+            put_u32(skip, narrow(prev));
+            put_u32(skip + 4, narrow(static_cast<size_t>(p - blocks)));
+            put_u32(skip + 8, narrow(block_max));
+            skip += PostingCursor::SKIP_ENTRY;
+        }
+    }
+}
+
+static size_t positions_size(const std::vector<Entry>& postings, const std::vector<uint32_t>& positions) {
+    const size_t blocks = (postings.size() + PostingCursor::BLOCK - 1) / PostingCursor::BLOCK;
+    size_t bytes = blocks > 1 ? blocks * 4 : 0, k = 0;
+    for (const auto& e : postings) {
+        uint32_t prev = 0;
+        for (size_t j = 0; j < e.count; ++j, ++k) {
+            bytes += varint_size(positions[k] - prev);
+            prev = positions[k];
+        }
+    }
+    return bytes;
+}
+
+// формат описан у PositionReader (PostingCursor.h)
+static void encode_positions(const std::vector<Entry>& postings, const std::vector<uint32_t>& positions,
+                             uint8_t* out) {
+    const size_t blocks = (postings.size() + PostingCursor::BLOCK - 1) / PostingCursor::BLOCK;
+    uint8_t* table = out;
+    uint8_t* const data = out + (blocks > 1 ? blocks * 4 : 0);
+    uint8_t* p = data;
+    size_t k = 0;
+    for (size_t i = 0; i < postings.size(); ++i) {
+        if (blocks > 1 && i % PostingCursor::BLOCK == 0) {
+            put_u32(table, narrow(static_cast<size_t>(p - data)));
+            table += 4;
+        }
+        uint32_t prev = 0;
+        for (size_t j = 0; j < postings[i].count; ++j, ++k) {
+            p = put_varint(p, positions[k] - prev);
+            prev = positions[k];
+        }
+    }
+}
+
+// Образ: заголовок, затем секции, каждая выровнена на 8 байт
+struct ImageHeader {
+    uint64_t terms;
+    uint64_t arena_bytes;
+    uint64_t postings_bytes;
+    uint64_t positions_bytes;   // 0 — индекс без позиций
+    uint64_t codec;             // PostingCodec блоков posting-листов
+};
+
+struct Layout {
+    size_t term_offsets, post_offsets, doc_freq, max_count, arena, postings, pos_offsets, positions, total;
+};
+
+static size_t align8(size_t x) { return (x + 7) & ~size_t(7); }
+
+static Layout layout_of(const ImageHeader& h) {
+    Layout l{};
+    size_t off = align8(sizeof(ImageHeader));
+    l.term_offsets = off; off = align8(off + (h.terms + 1) * sizeof(uint32_t));
+    l.post_offsets = off; off = align8(off + (h.terms + 1) * sizeof(uint64_t));
+    l.doc_freq     = off; off = align8(off + h.terms * sizeof(uint32_t));
+    l.max_count    = off; off = align8(off + h.terms * sizeof(uint32_t));
+    l.arena        = off; off = align8(off + h.arena_bytes);
+    l.postings     = off; off = align8(off + h.postings_bytes);
+    // позиции — в самом конце: запросы без фраз до этих страниц не доходят
+    const size_t pos_terms = h.positions_bytes ? h.terms + 1 : 0;
+    l.pos_offsets  = off; off = align8(off + pos_terms * sizeof(uint64_t));
+    l.positions    = off; off = align8(off + h.positions_bytes);
+    l.total = off;
+    return l;
+}
+
+void CompactIndex::clear() {
+    storage_.clear(); storage_.shrink_to_fit();
+    owner_.reset();
+    image_ = nullptr; image_size_ = 0;
+    terms_ = 0;
+    codec_ = PostingCodec::Varint;
+    arena_ = nullptr; term_offsets_ = nullptr; post_offsets_ = nullptr;
+    doc_freq_ = nullptr; max_count_ = nullptr; postings_ = nullptr;
+    pos_offsets_ = nullptr; positions_ = nullptr;
+}
+
+void CompactIndex::bind(const uint8_t* image, size_t size) {
+    ImageHeader h;
+    std::memcpy(&h, image, sizeof(h));
+    const Layout l = layout_of(h);
+    image_ = image;
+    image_size_ = size;
+    terms_ = static_cast<size_t>(h.terms);
+    codec_ = static_cast<PostingCodec>(h.codec);
+    term_offsets_ = reinterpret_cast<const uint32_t*>(image + l.term_offsets);
+    post_offsets_ = reinterpret_cast<const uint64_t*>(image + l.post_offsets);
+    doc_freq_     = reinterpret_cast<const uint32_t*>(image + l.doc_freq);
+    max_count_    = reinterpret_cast<const uint32_t*>(image + l.max_count);
+    arena_        = reinterpret_cast<const char*>(image + l.arena);
+    postings_     = image + l.postings;
+    pos_offsets_  = h.positions_bytes ? reinterpret_cast<const uint64_t*>(image + l.pos_offsets) : nullptr;
+    positions_    = h.positions_bytes ? image + l.positions : nullptr;
+}
+
+void CompactIndex::attach(const uint8_t* image, size_t size, std::shared_ptr<const void> owner) {
+    clear();
+    if (size < sizeof(ImageHeader) || reinterpret_cast<uintptr_t>(image) % 8 != 0)
+        throw std::runtime_error("index image is corrupted");
+    ImageHeader h;
+    std::memcpy(&h, image, sizeof(h));
+    // размеры секций не должны выходить за образ (и переполнять size_t)
+    if (h.terms > size || h.arena_bytes > size || h.postings_bytes > size || h.positions_bytes > size
+        || h.codec > static_cast<uint64_t>(PostingCodec::BitPack) || layout_of(h).total != size)
+        throw std::runtime_error("index image is corrupted");
+    bind(image, size);
+    if (term_offsets_[terms_] != h.arena_bytes || post_offsets_[terms_] != h.postings_bytes
+        || (pos_offsets_ && pos_offsets_[terms_] != h.positions_bytes)) {
+        clear();
+        throw std::runtime_error("index image is corrupted");
+    }
+    owner_ = std::move(owner);
+}
+
+void CompactIndex::build(std::vector<TermPostings> terms, ThreadPool* pool, PostingCodec codec) {
+    clear();
+    std::sort(terms.begin(), terms.end(),
+              [](const TermPostings& a, const TermPostings& b){ return a.term < b.term; });
+
+    const size_t v = terms.size();
+    auto for_ranges = [&](auto&& fn) {
+        const size_t parts = pool ? std::min(v, pool->size() * 4) : 1;
+        if (parts <= 1) { fn(size_t(0), v); return; }
+        pool->parallel_for(parts, [&](size_t c){ fn(v * c / parts, v * (c + 1) / parts); });
+    };
+
+    // размеры листов -> раскладка образа -> кодирование прямо в образ
+    std::vector<uint64_t> post_offsets(v + 1, 0);
+    for_ranges([&](size_t b, size_t e){
+        for (size_t i = b; i < e; ++i) post_offsets[i + 1] = encoded_size(*terms[i].postings, codec);
+    });
+    for (size_t i = 0; i < v; ++i) post_offsets[i + 1] += post_offsets[i];
+
+    const bool with_positions = v > 0 && std::all_of(terms.begin(), terms.end(),
+        [](const TermPostings& t){ return t.positions != nullptr; });
+    std::vector<uint64_t> pos_offsets(with_positions ? v + 1 : 0, 0);
+    if (with_positions) {
+        for_ranges([&](size_t b, size_t e){
+            for (size_t i = b; i < e; ++i) pos_offsets[i + 1] = positions_size(*terms[i].postings, *terms[i].positions);
+        });
+        for (size_t i = 0; i < v; ++i) pos_offsets[i + 1] += pos_offsets[i];
+    }
+
+    ImageHeader h{ v, 0, post_offsets[v], with_positions ? pos_offsets[v] : 0, static_cast<uint64_t>(codec) };
+    for (const auto& t : terms) h.arena_bytes += t.term.size();
+    const Layout l = layout_of(h);
+    storage_.assign(l.total / sizeof(uint64_t), 0);
+    uint8_t* img = reinterpret_cast<uint8_t*>(storage_.data());
+    std::memcpy(img, &h, sizeof(h));
+
+    auto* term_offsets = reinterpret_cast<uint32_t*>(img + l.term_offsets);
+    auto* doc_freq     = reinterpret_cast<uint32_t*>(img + l.doc_freq);
+    auto* max_count    = reinterpret_cast<uint32_t*>(img + l.max_count);
+    char* arena        = reinterpret_cast<char*>(img + l.arena);
+    size_t arena_pos = 0;
+    for (size_t i = 0; i < v; ++i) {
+        const auto& t = terms[i];
+        term_offsets[i] = narrow(arena_pos);
+        std::memcpy(arena + arena_pos, t.term.data(), t.term.size());
+        arena_pos += t.term.size();
+        doc_freq[i] = narrow(t.postings->size());
+        size_t mx = 0;
+        for (const auto& e : *t.postings) mx = std::max(mx, e.count);
+        max_count[i] = narrow(mx);
+    }
+    term_offsets[v] = narrow(arena_pos);
+    std::memcpy(img + l.post_offsets, post_offsets.data(), post_offsets.size() * sizeof(uint64_t));
+
+    uint8_t* postings = img + l.postings;
+    for_ranges([&](size_t b, size_t e){
+        for (size_t i = b; i < e; ++i) encode(*terms[i].postings, codec, postings + post_offsets[i]);
+    });
+    if (with_positions) {
+        std::memcpy(img + l.pos_offsets, pos_offsets.data(), pos_offsets.size() * sizeof(uint64_t));
+        uint8_t* positions = img + l.positions;
+        for_ranges([&](size_t b, size_t e){
+            for (size_t i = b; i < e; ++i)
+                encode_positions(*terms[i].postings, *terms[i].positions, positions + pos_offsets[i]);
+        });
+    }
+
+    bind(img, l.total);
+}
+
+size_t CompactIndex::find(std::string_view word) const {
+    size_t lo = 0, hi = term_count();
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (term(mid) < word) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < term_count() && term(lo) == word) ? lo : npos;
+}
+
+void CompactIndex::decode(size_t t, std::vector<Entry>& out) const {
+    out.reserve(out.size() + doc_freq_[t]);
+    for (PostingCursor c = cursor(t); !c.at_end(); c.next()) out.push_back(Entry{ c.doc(), c.count() });
+}
+
+size_t CompactIndex::memory_usage() const {
+    return image_size_;
+}
@@ -1,8 +1,9 @@
 #include "ConverterJSON.h"
+#include "JsonWriter.h"
+#include <algorithm>
 #include <nlohmann/json.hpp>
 #include <filesystem>
 #include <fstream>
-#include <sstream>
 #include <stdexcept>
 #include <iostream>
 
@@ -14,11 +15,24 @@ static constexpr const char* APP_VERSION = "0.1";
 static std::string read_file(const fs::path& p) {
     std::ifstream ifs(p, std::ios::binary);
     if (!ifs) throw std::runtime_error("Cannot open file: " + p.string());
-    std::ostringstream ss; ss << ifs.rdbuf();
-    return ss.str();
+    // читаем сразу в строку нужного размера, без промежуточного ostringstream
+    std::string text;
+    ifs.seekg(0, std::ios::end);
+    const auto size = ifs.tellg();
+    if (size > 0) {
+        text.resize(static_cast<size_t>(size));
+        ifs.seekg(0, std::ios::beg);
+        ifs.read(&text[0], static_cast<std::streamsize>(text.size()));
+        text.resize(static_cast<size_t>(ifs.gcount()));
+    }
+    return text;
 }
 
-void ConverterJSON::setResourcesDir(const std::string& dir) { resources_dir_ = dir; }
+void ConverterJSON::setResourcesDir(const std::string& dir) {
+    resources_dir_ = dir;
+    config_.reset();
+    requests_.reset();
+}
 
 // ---- внутренний разбор config.json с валидацией по ТЗ ----
 static json parse_config_or_throw(const fs::path& cfg_path) {
@@ -34,22 +48,32 @@ static json parse_config_or_throw(const fs::path& cfg_path) {
     return j;
 }
 
+const json& ConverterJSON::config() {
+    if (!config_) config_ = std::make_shared<const json>(parse_config_or_throw(fs::path(resources_dir_) / "config.json"));
+    return *config_;
+}
+
+// путь документа из config.json["files"]
+static fs::path resolve_document_path(const std::string& dir, const std::string& item) {
+    // допускаем относительные пути из ТЗ; читаем фактический файл как есть
+    fs::path p = item;
+    // если путь относительный — считаем, что он от папки resources
+    if (p.is_relative()) p = fs::path(dir) / p;
+    // некоторые студенты кладут рядом, без ../ — подстрахуем filename() в resources
+    if (!fs::exists(p)) {
+        fs::path fallback = fs::path(dir) / p.filename();
+        if (fs::exists(fallback)) p = fallback;
+    }
+    return p;
+}
+
 std::vector<std::string> ConverterJSON::GetTextDocuments() {
-    const fs::path cfg = fs::path(resources_dir_) / "config.json";
-    json j = parse_config_or_throw(cfg);
+    const json& j = config();
 
     std::vector<std::string> docs;
     if (j.contains("files") && j["files"].is_array()) {
         for (const auto& item : j["files"]) {
-            // допускаем относительные пути из ТЗ; читаем фактический файл как есть
-            fs::path p = item.get<std::string>();
-            // если путь относительный — считаем, что он от папки resources
-            if (p.is_relative()) p = fs::path(resources_dir_) / p;
-            // некоторые студенты кладут рядом, без ../ — подстрахуем filename() в resources
-            if (!fs::exists(p)) {
-                fs::path fallback = fs::path(resources_dir_) / p.filename();
-                if (fs::exists(fallback)) p = fallback;
-            }
+            const fs::path p = resolve_document_path(resources_dir_, item.get<std::string>());
             if (fs::exists(p)) {
                 try { docs.push_back(read_file(p)); }
                 catch (...) { std::cerr << "Cannot read file: " << p.string() << "\n"; }
@@ -62,9 +86,22 @@ std::vector<std::string> ConverterJSON::GetTextDocuments() {
     return docs;
 }
 
+std::vector<std::string> ConverterJSON::GetTextDocumentPaths() {
+    const json& j = config();
+
+    std::vector<std::string> paths;
+    if (j.contains("files") && j["files"].is_array()) {
+        for (const auto& item : j["files"]) {
+            const fs::path p = resolve_document_path(resources_dir_, item.get<std::string>());
+            if (fs::exists(p)) paths.push_back(p.string());
+            else std::cerr << "File not found: " << p.string() << "\n";
+        }
+    }
+    return paths;
+}
+
 int ConverterJSON::GetResponsesLimit() {
-    const fs::path cfg = fs::path(resources_dir_) / "config.json";
-    json j = parse_config_or_throw(cfg);
+    const json& j = config();
     int limit = 5;
     if (j["config"].contains("max_responses")) {
         try { limit = j["config"]["max_responses"].get<int>(); }
@@ -74,33 +111,331 @@ int ConverterJSON::GetResponsesLimit() {
     return limit;
 }
 
+// неотрицательное целое из config; при ошибке или отсутствии — 0
+static size_t get_count(const json& j, const char* key) {
+    int threads = 0;
+    if (j["config"].contains(key)) {
+        try { threads = j["config"][key].get<int>(); }
+        catch (...) { threads = 0; }
+    }
+    return threads > 0 ? static_cast<size_t>(threads) : 0;
+}
+
+// ограничение из config: нет ключа или ошибка — def, 0 — без ограничения
+static size_t get_limit(const json& j, const char* key, size_t def) {
+    if (!j["config"].contains(key)) return def;
+    try {
+        const int v = j["config"][key].get<int>();
+        return v >= 0 ? static_cast<size_t>(v) : def;
+    } catch (...) { return def; }
+}
+
+static size_t max_doc_words(const json& j) {
+    return get_limit(j, "max_doc_words", 1000);
+}
+
+size_t ConverterJSON::GetMaxDocWords() {
+    return max_doc_words(config());
+}
+
+size_t ConverterJSON::GetMaxRequests() {
+    return get_limit(config(), "max_requests", 1000);
+}
+
+size_t ConverterJSON::GetMaxQueryWords() {
+    return get_limit(config(), "max_query_words", 10);
+}
+
+size_t ConverterJSON::GetRequestBatch() {
+    const size_t batch = get_count(config(), "request_batch");
+    return batch ? batch : 1000;
+}
+
+size_t ConverterJSON::GetIndexThreads() {
+    return get_count(config(), "index_threads");
+}
+
+size_t ConverterJSON::GetSearchThreads() {
+    return get_count(config(), "search_threads");
+}
+
+size_t ConverterJSON::GetShardCount() {
+    return std::max<size_t>(1, get_count(config(), "shards"));
+}
+
+std::vector<std::string> ConverterJSON::GetShardAddresses() {
+    const json& j = config();
+    std::vector<std::string> out;
+    if (j["config"].contains("shard_addresses") && j["config"]["shard_addresses"].is_array()) {
+        for (const auto& a : j["config"]["shard_addresses"])
+            if (a.is_string()) out.push_back(a.get<std::string>());
+    }
+    return out;
+}
+
+size_t ConverterJSON::GetCacheBytes() {
+    return get_count(config(), "cache_mb") << 20;
+}
+
+std::string ConverterJSON::GetRanking() {
+    const json& j = config();
+    if (j["config"].contains("ranking") && j["config"]["ranking"].is_string())
+        return j["config"]["ranking"].get<std::string>();
+    return "count";
+}
+
+std::string ConverterJSON::GetMatch() {
+    const json& j = config();
+    if (j["config"].contains("match") && j["config"]["match"].is_string())
+        return j["config"]["match"].get<std::string>();
+    return "all";
+}
+
+size_t ConverterJSON::GetMinShouldMatch() {
+    return std::max<size_t>(1, get_count(config(), "min_should_match"));
+}
+
+static bool store_positions(const json& j) {
+    return !(j["config"].contains("positions") && j["config"]["positions"].is_boolean()
+             && !j["config"]["positions"].get<bool>());
+}
+
+bool ConverterJSON::GetStorePositions() {
+    return store_positions(config());
+}
+
+static std::string posting_codec(const json& j) {
+    if (j["config"].contains("codec") && j["config"]["codec"].is_string())
+        return j["config"]["codec"].get<std::string>();
+    return "varint";
+}
+
+std::string ConverterJSON::GetPostingCodec() {
+    return posting_codec(config());
+}
+
+std::string ConverterJSON::GetIndexFile() {
+    const json& j = config();
+    fs::path p = "index.bin";
+    if (j["config"].contains("index_file")) {
+        try { p = j["config"]["index_file"].get<std::string>(); }
+        catch (...) { p = "index.bin"; }
+    }
+    if (p.is_relative()) p = fs::path(resources_dir_) / p;
+    return p.string();
+}
+
+// FNV-1a
+static void fingerprint_mix(uint64_t& h, const void* data, size_t n) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 0x100000001B3ull; }
+}
+
+uint64_t ConverterJSON::GetConfigFingerprint() {
+    const json& j = config();
+
+    uint64_t h = 0xCBF29CE484222325ull;
+    fingerprint_mix(h, APP_VERSION, std::char_traits<char>::length(APP_VERSION));
+    // индекс без позиций не годится, если их включили (и наоборот)
+    const char positions = store_positions(j) ? 'p' : '-';
+    fingerprint_mix(h, &positions, 1);
+    // и при смене кодировки листов индекс перестраивается в новой
+    const std::string codec = posting_codec(j);
+    fingerprint_mix(h, codec.data(), codec.size() + 1);
+    // от ограничения слов зависит содержимое индекса
+    const uint64_t doc_words = max_doc_words(j);
+    fingerprint_mix(h, &doc_words, sizeof(doc_words));
+    if (j.contains("files") && j["files"].is_array()) {
+        for (const auto& item : j["files"]) {
+            const fs::path p = resolve_document_path(resources_dir_, item.get<std::string>());
+            const std::string name = p.lexically_normal().string();
+            fingerprint_mix(h, name.data(), name.size() + 1);
+            std::error_code ec;
+            const uint64_t size = fs::exists(p, ec) ? static_cast<uint64_t>(fs::file_size(p, ec)) : UINT64_MAX;
+            const int64_t mtime = fs::exists(p, ec)
+                ? static_cast<int64_t>(fs::last_write_time(p, ec).time_since_epoch().count()) : 0;
+            fingerprint_mix(h, &size, sizeof(size));
+            fingerprint_mix(h, &mtime, sizeof(mtime));
+        }
+    }
+    return h;
+}
+
 std::vector<std::string> ConverterJSON::GetRequests() {
+    if (requests_) return *requests_;
     const fs::path rq = fs::path(resources_dir_) / "requests.json";
-    std::vector<std::string> reqs;
-    if (!fs::exists(rq)) return reqs;
-    json j = json::parse(read_file(rq));
-    if (j.contains("requests") && j["requests"].is_array()) {
-        for (auto& it : j["requests"]) reqs.push_back(it.get<std::string>());
+    auto reqs = std::make_shared<std::vector<std::string>>();
+    if (fs::exists(rq)) {
+        const json j = json::parse(read_file(rq));
+        if (j.contains("requests") && j["requests"].is_array()) {
+            reqs->reserve(j["requests"].size());
+            for (const auto& it : j["requests"]) reqs->push_back(it.get<std::string>());
+        }
     }
-    return reqs;
+    requests_ = std::move(reqs);
+    return *requests_;
 }
 
-void ConverterJSON::putAnswers(const std::vector<std::vector<std::pair<int, float>>>& answers) {
-    json out; json answers_obj;
-
-    for (size_t i = 0; i < answers.size(); ++i) {
-        char idbuf[16]; std::snprintf(idbuf, sizeof(idbuf), "request%03zu", i + 1);
-        if (answers[i].empty()) {
-            answers_obj[idbuf] = { {"result", "false"} };
-        } else {
-            json rel = json::array();
-            for (auto& [doc, rank] : answers[i]) rel.push_back({ {"docid", doc}, {"rank", rank} });
-            answers_obj[idbuf] = { {"result", "true"}, {"relevance", rel} };
+// ключ ответа: request001, request002, ... (не меньше трёх цифр)
+static std::string answer_key(size_t i) {
+    std::string n = std::to_string(i + 1);
+    if (n.size() < 3) n.insert(0, 3 - n.size(), '0');
+    return "request" + n;
+}
+
+// ответ на один запрос: {"relevance": [...], "result": "true"} или {"result": "false"}
+static void write_answer(JsonWriter& w, const std::string& key, const std::vector<std::pair<int, float>>& answer) {
+    w.key(key);
+    w.beginObject();
+    if (!answer.empty()) {
+        w.key("relevance");
+        w.beginArray();
+        for (const auto& [doc, rank] : answer) {
+            w.beginObject();
+            w.key("docid");
+            w.value(doc);
+            w.key("rank");
+            w.value(static_cast<double>(rank));
+            w.endObject();
         }
+        w.endArray();
     }
-    out["answers"] = answers_obj;
+    w.key("result");
+    w.value(answer.empty() ? "false" : "true");
+    w.endObject();
+}
 
+void ConverterJSON::putAnswers(const std::vector<std::vector<std::pair<int, float>>>& answers) {
     const fs::path ans = fs::path(resources_dir_) / "answers.json";
-    std::ofstream ofs(ans, std::ios::trunc);
-    ofs << out.dump(2);
+    std::ofstream ofs(ans, std::ios::trunc | std::ios::binary);
+    if (!ofs) throw std::runtime_error("Cannot write file: " + ans.string());
+
+    // Схема и оформление прежние (как у json::dump(2)): ключи объектов по
+    // алфавиту — поэтому request1000 идёт за request100, а "relevance" перед "result".
+    std::vector<std::string> keys(answers.size());
+    std::vector<size_t> order(answers.size());
+    for (size_t i = 0; i < answers.size(); ++i) { keys[i] = answer_key(i); order[i] = i; }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b){ return keys[a] < keys[b]; });
+
+    JsonWriter w(ofs, 2);
+    w.beginObject();
+    w.key("answers");
+    if (answers.empty()) w.null();
+    else {
+        w.beginObject();
+        for (size_t i : order) write_answer(w, keys[i], answers[i]);
+        w.endObject();
+    }
+    w.endObject();
+}
+
+namespace {
+
+// SAX-разбор requests.json: строки массива "requests" верхнего уровня
+// собираются в пачку; полная пачка сразу уходит в on_batch.
+class RequestsSax : public nlohmann::json_sax<json> {
+public:
+    RequestsSax(size_t batch_size, size_t max_requests, std::function<void(std::vector<std::string>&)> on_batch)
+        : batch_size_(batch_size), max_requests_(max_requests), on_batch_(std::move(on_batch)) {
+        batch_.reserve(batch_size_);
+    }
+
+    size_t total() const { return total_; }
+    // остаток последней неполной пачки
+    void finish() { if (!batch_.empty()) on_batch_(batch_); }
+
+    bool string(string_t& s) override {
+        if (!in_requests()) return true;
+        ++total_;
+        if (max_requests_ && total_ > max_requests_) return true; // только считаем
+        batch_.push_back(std::move(s));
+        if (batch_.size() == batch_size_) { on_batch_(batch_); batch_.clear(); }
+        return true;
+    }
+    bool null() override { return scalar(); }
+    bool boolean(bool) override { return scalar(); }
+    bool number_integer(number_integer_t) override { return scalar(); }
+    bool number_unsigned(number_unsigned_t) override { return scalar(); }
+    bool number_float(number_float_t, const string_t&) override { return scalar(); }
+    bool binary(binary_t&) override { return scalar(); }
+    bool start_object(size_t) override {
+        scalar();
+        ++depth_;
+        return true;
+    }
+    bool end_object() override { --depth_; return true; }
+    bool key(string_t& k) override {
+        requests_key_ = (depth_ == 1 && k == "requests");
+        return true;
+    }
+    bool start_array(size_t) override {
+        scalar();
+        ++depth_;
+        if (depth_ == 2 && requests_key_) array_depth_ = depth_;
+        return true;
+    }
+    bool end_array() override {
+        if (depth_ == array_depth_) array_depth_ = 0;
+        --depth_;
+        return true;
+    }
+    bool parse_error(size_t, const std::string&, const nlohmann::detail::exception& e) override {
+        throw std::runtime_error(std::string("requests.json: ") + e.what());
+    }
+
+private:
+    bool in_requests() const { return array_depth_ != 0 && depth_ == array_depth_; }
+    // запросом может быть только строка (как и в GetRequests)
+    bool scalar() {
+        if (in_requests()) throw std::runtime_error("requests.json: request is not a string");
+        return true;
+    }
+
+    size_t batch_size_, max_requests_;
+    std::function<void(std::vector<std::string>&)> on_batch_;
+    std::vector<std::string> batch_;
+    size_t total_ = 0;
+    size_t depth_ = 0;
+    size_t array_depth_ = 0;   // глубина массива "requests", пока внутри него
+    bool requests_key_ = false;
+};
+
+} // namespace
+
+size_t ConverterJSON::ProcessRequests(size_t batch_size, size_t max_requests, const BatchHandler& handler) {
+    const fs::path rq = fs::path(resources_dir_) / "requests.json";
+    const fs::path ans = fs::path(resources_dir_) / "answers.json";
+    // пишем во временный файл: прерванная обработка не портит прежний answers.json
+    const fs::path tmp = ans.string() + ".tmp";
+    std::ofstream ofs(tmp, std::ios::trunc | std::ios::binary);
+    if (!ofs) throw std::runtime_error("Cannot write file: " + tmp.string());
+
+    JsonWriter w(ofs, 2);
+    w.beginObject();
+    w.key("answers");
+    size_t done = 0;
+    RequestsSax sax(std::max<size_t>(1, batch_size), max_requests, [&](std::vector<std::string>& batch) {
+        const Answers answers = handler(batch);
+        if (answers.size() != batch.size()) throw std::runtime_error("answers do not match requests");
+        if (done == 0) w.beginObject();
+        for (const auto& a : answers) write_answer(w, answer_key(done++), a);
+    });
+    if (fs::exists(rq)) {
+        std::ifstream ifs(rq, std::ios::binary);
+        if (!ifs) throw std::runtime_error("Cannot open file: " + rq.string());
+        json::sax_parse(ifs, &sax);
+        sax.finish();
+    }
+    if (max_requests && sax.total() > max_requests) {
+        std::cerr << "[Search] Requests truncated to " << max_requests
+                  << " (had " << sax.total() << ")\n";
+    }
+    if (done == 0) w.null();
+    else w.endObject();
+    w.endObject();
+    w.flush();
+    ofs.close();
+    if (!ofs) throw std::runtime_error("Cannot write file: " + tmp.string());
+    fs::rename(tmp, ans);
+    return done;
 }
@@ -1,79 +1,838 @@
 #include "InvertedIndex.h"
-#include <sstream>
+#include "BoundedQueue.h"
+#include "MappedFile.h"
+#include "Metrics.h"
+#include "ThreadPool.h"
+#include "Tokenizer.h"
+#include <deque>
 #include <unordered_map>
 #include <algorithm>
-#include <thread>
-#include <mutex>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory_resource>
+#include <stdexcept>
 
 // ---- ограничения ТЗ ----
-static constexpr size_t MAX_WORD_LEN   = 100;   // длина слова ≤ 100
-static constexpr size_t MAX_DOC_WORDS  = 1000;  // в документе ≤ 1000 слов
+static constexpr size_t MAX_WORD_LEN   = Tokenizer::MAX_WORD_LEN;   // длина слова ≤ 100
 
-// оставляем только [a-z] и пробелы, приводим к нижнему регистру
-static std::string normalize(std::string s) {
-    for (char& ch : s) {
-        if (ch >= 'A' && ch <= 'Z') ch = char(ch - 'A' + 'a');
-        else if (!((ch >= 'a' && ch <= 'z') || ch == ' ')) ch = ' ';
+// Документ от LARGE_DOC_BYTES (при снятом ограничении числа слов) режется по
+// пробельным символам на части около PIECE_BYTES, которые разбираются параллельно.
+static constexpr size_t LARGE_DOC_BYTES = size_t(1) << 20;
+static constexpr size_t PIECE_BYTES     = size_t(256) << 10;
+
+// Переиспользуемые буферы разбора одного документа (без выделения памяти на
+// каждое слово). Ключи words указывают в текст документа, а если слово пришлось
+// перевести в нижний регистр — в owned; оба должны жить, пока жив words.
+// Узлы словаря и owned берутся из пула: clear() возвращает их туда, и со
+// второго документа разбор обходится без обращений к куче.
+struct DocWords {
+    struct Slot {
+        size_t count = 0;
+        size_t end = 0;   // позиции слова — positions[end - count, end)
+    };
+    std::pmr::unsynchronized_pool_resource pool;
+    std::pmr::unordered_map<std::string_view, Slot> words{ &pool };
+    std::pmr::deque<std::pmr::string> owned{ &pool };
+    std::vector<Slot*> sequence;      // слово на каждой позиции (узлы words не переезжают)
+    std::vector<uint32_t> positions;  // позиции, сгруппированные по словам
+
+    // позиции слова по возрастанию
+    const uint32_t* begin(const Slot& s) const { return positions.data() + (s.end - s.count); }
+    const uint32_t* end(const Slot& s) const { return positions.data() + s.end; }
+};
+
+// как разбирать документы при построении
+struct ParseOptions {
+    bool positions = true;
+    size_t max_words = InvertedIndex::MAX_DOC_WORDS; // 0 — без ограничения
+    ThreadPool* pool = nullptr;                       // для разбора больших документов по частям
+};
+
+// Разобрать документ: счётчики слов, а если with_positions — и позиции вхождений.
+// Учитываются первые max_words слов (0 — все). Возвращает длину документа —
+// число учтённых слов.
+static uint32_t count_words(std::string_view raw, DocWords& dw, bool with_positions, size_t max_words) {
+    dw.words.clear();
+    dw.owned.clear();
+    dw.sequence.clear();
+    Tokenizer tok(raw, MAX_WORD_LEN);
+    std::string_view w;
+    size_t words = 0;
+    const size_t limit = max_words ? max_words : SIZE_MAX;
+    while (tok.next(w)) {
+        // Ограничиваем документ по количеству слов (дальше только считаем для сообщения)
+        if (words++ >= limit) continue;
+        auto it = dw.words.find(w);
+        if (it == dw.words.end()) {
+            if (!tok.stable()) w = dw.owned.emplace_back(w);
+            it = dw.words.emplace(w, DocWords::Slot{}).first;
+        }
+        ++it->second.count;
+        if (with_positions) dw.sequence.push_back(&it->second);
+    }
+    if (words > limit) {
+        SE_METRIC_ADD(IndexDocsTruncated, 1);
+        std::cerr << "[Index] Document truncated to " << limit
+                  << " words (had " << words << ")\n";
+    }
+    if (with_positions) {
+        // раскладываем позиции по словам: сначала границы, потом заполнение
+        size_t off = 0;
+        for (auto& [word, slot] : dw.words) { off += slot.count; slot.end = off - slot.count; }
+        dw.positions.resize(off);
+        for (size_t i = 0; i < dw.sequence.size(); ++i)
+            dw.positions[dw.sequence[i]->end++] = static_cast<uint32_t>(i);
+    }
+    words = std::min(words, limit);
+    if (words > UINT32_MAX) throw std::runtime_error("document is too long");
+    return static_cast<uint32_t>(words);
+}
+
+// Большой документ: части (границы — пробельные символы, слова не рвутся)
+// разбираются параллельно каждая в свой DocWords, затем счётчики складываются,
+// а позиции сдвигаются на число слов в предыдущих частях. Результат — в dw,
+// как у count_words; ключи dw указывают в text и в буферы частей из parts.
+static uint32_t count_words_split(std::string_view text, DocWords& dw, bool with_positions,
+                                  ThreadPool& pool, std::vector<std::unique_ptr<DocWords>>& parts) {
+    const auto is_space = [](char ch){ return ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r'; };
+    std::vector<std::string_view> pieces;
+    for (size_t start = 0; start < text.size();) {
+        size_t end = std::min(text.size(), start + PIECE_BYTES);
+        while (end < text.size() && !is_space(text[end])) ++end;
+        pieces.push_back(text.substr(start, end - start));
+        start = end;
+    }
+    parts.resize(pieces.size());
+    std::vector<size_t> lengths(pieces.size());
+    pool.parallel_for(pieces.size(), [&](size_t k) {
+        if (!parts[k]) parts[k] = std::make_unique<DocWords>();
+        lengths[k] = count_words(pieces[k], *parts[k], with_positions, 0);
+    });
+
+    dw.words.clear();
+    dw.owned.clear();
+    dw.sequence.clear();
+    for (size_t k = 0; k < pieces.size(); ++k)
+        for (const auto& [word, slot] : parts[k]->words) dw.words[word].count += slot.count;
+    size_t total = 0;
+    for (size_t len : lengths) total += len;
+    if (total > UINT32_MAX) throw std::runtime_error("document is too long");
+
+    if (with_positions) {
+        size_t off = 0;
+        for (auto& [word, slot] : dw.words) { off += slot.count; slot.end = off - slot.count; }
+        dw.positions.resize(off);
+        // части по порядку — позиции каждого слова остаются возрастающими
+        uint32_t shift = 0;
+        for (size_t k = 0; k < pieces.size(); ++k) {
+            const DocWords& part = *parts[k];
+            for (const auto& [word, slot] : part.words) {
+                DocWords::Slot& dst = dw.words.find(word)->second;
+                for (const uint32_t* p = part.begin(slot); p != part.end(slot); ++p)
+                    dw.positions[dst.end++] = *p + shift;
+            }
+            shift += static_cast<uint32_t>(lengths[k]);
+        }
+    }
+    return static_cast<uint32_t>(total);
+}
+
+bool Segment::contains(size_t doc) const {
+    return std::binary_search(docs.begin(), docs.end(), doc,
+                              [](size_t a, size_t b){ return a < b; });
+}
+
+size_t Segment::position(size_t doc) const {
+    // базовый сегмент плотный (docs = min..max), там позиция вычисляется сразу
+    if (docs.back() - docs.front() + 1 == docs.size()) return doc - docs.front();
+    return static_cast<size_t>(std::lower_bound(docs.begin(), docs.end(), doc,
+        [](uint32_t a, size_t b){ return a < b; }) - docs.begin());
+}
+
+InvertedIndex::~InvertedIndex() {
+    WaitForMerges();
+}
+
+std::shared_ptr<const IndexSnapshot> InvertedIndex::Snapshot() const {
+    return std::atomic_load(&snapshot_);
+}
+
+// вызывается под write_mutex_
+void InvertedIndex::publish(std::shared_ptr<IndexSnapshot> snap, bool same_results) {
+    snap->generation = same_results ? Snapshot()->generation : ++generation_;
+    std::atomic_store(&snapshot_, std::shared_ptr<const IndexSnapshot>(std::move(snap)));
+}
+
+// ---- построение базового сегмента ----
+static constexpr size_t SHARDS = 64; // на время построения словарь разбит по хешу слова
+
+// posting-лист на время построения; позиции — подряд, entries[i].count штук на запись
+struct BuildList {
+    std::vector<Entry> entries;
+    std::vector<uint32_t> positions;
+};
+
+// Частичный индекс одного воркера, разложенный по шардам. Ключи и узлы
+// словарей лежат в арене воркера: слово копируется туда один раз, при первой
+// встрече, а не на каждый posting. Арена освобождается вместе с Partial.
+struct Partial {
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena =
+        std::make_unique<std::pmr::monotonic_buffer_resource>(64 * 1024);
+    std::vector<std::pmr::unordered_map<std::string_view, BuildList>> shards;
+
+    Partial() {
+        shards.reserve(SHARDS);
+        for (size_t s = 0; s < SHARDS; ++s) shards.emplace_back(arena.get());
+    }
+
+    // лист слова в шарде s (слово копируется в арену, если встретилось впервые)
+    BuildList& list(size_t s, std::string_view word) {
+        auto& dict = shards[s];
+        auto it = dict.find(word);
+        if (it != dict.end()) return it->second;
+        char* copy = static_cast<char*>(arena->allocate(word.size(), 1));
+        std::memcpy(copy, word.data(), word.size());
+        return dict[std::string_view(copy, word.size())];
+    }
+};
+
+static size_t shard_of(std::string_view word) {
+    return std::hash<std::string_view>{}(word) % SHARDS;
+}
+
+// проиндексировать документ в частичный индекс; dw — переиспользуемые буферы.
+// Возвращает длину документа.
+static uint32_t index_document(std::string_view text, size_t doc_id, Partial& part,
+                               DocWords& dw, const ParseOptions& opt) {
+    SE_METRIC_TIMER(IndexTokenizeNs);
+    SE_METRIC_ADD(IndexDocuments, 1);
+    std::vector<std::unique_ptr<DocWords>> parts; // буферы частей большого документа
+    const uint32_t length = (opt.pool && opt.max_words == 0 && text.size() >= LARGE_DOC_BYTES)
+        ? count_words_split(text, dw, opt.positions, *opt.pool, parts)
+        : count_words(text, dw, opt.positions, opt.max_words);
+    for (const auto& [word, slot] : dw.words) {
+        BuildList& list = part.list(shard_of(word), word);
+        list.entries.push_back(Entry{ doc_id, slot.count });
+        if (opt.positions) list.positions.insert(list.positions.end(), dw.begin(slot), dw.end(slot));
     }
-    return s;
+    return length;
 }
 
-// Разбиваем на слова + фильтруем длину слова
-static std::vector<std::string> tokenize_doc(const std::string& raw) {
-    std::vector<std::string> words;
-    std::istringstream iss(normalize(raw));
-    std::string w;
-    while (iss >> w) {
-        if (w.size() <= MAX_WORD_LEN) words.push_back(w);
+// упорядочить лист по doc_id вместе с позициями
+static void sort_list(BuildList& list) {
+    auto& e = list.entries;
+    const auto by_doc = [](const Entry& a, const Entry& b){ return a.doc_id < b.doc_id; };
+    if (std::is_sorted(e.begin(), e.end(), by_doc)) return;
+    if (list.positions.empty()) { std::sort(e.begin(), e.end(), by_doc); return; }
+
+    std::vector<size_t> start(e.size() + 1, 0), order(e.size());
+    for (size_t i = 0; i < e.size(); ++i) { start[i + 1] = start[i] + e[i].count; order[i] = i; }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b){ return e[a].doc_id < e[b].doc_id; });
+    std::vector<Entry> entries;
+    std::vector<uint32_t> positions;
+    entries.reserve(e.size());
+    positions.reserve(list.positions.size());
+    for (size_t i : order) {
+        entries.push_back(e[i]);
+        positions.insert(positions.end(), list.positions.begin() + static_cast<std::ptrdiff_t>(start[i]),
+                         list.positions.begin() + static_cast<std::ptrdiff_t>(start[i + 1]));
     }
-    // Ограничиваем документ по количеству слов
-    if (words.size() > MAX_DOC_WORDS) {
-        std::cerr << "[Index] Document truncated to " << MAX_DOC_WORDS
-                  << " words (had " << words.size() << ")\n";
-        words.resize(MAX_DOC_WORDS);
+    list.entries = std::move(entries);
+    list.positions = std::move(positions);
+}
+
+// Слить частичные индексы по шардам (параллельно и без общей блокировки: каждый
+// шард собирает только свои слова) и заморозить в сегмент из документов 0..n-1
+// длиной lengths[i]. Ключи словарей указывают в арены partials, поэтому те
+// отпускаются только после заморозки. ordered — частичные индексы покрывают возрастающие
+// диапазоны doc_id, и конкатенация листов уже отсортирована; иначе листы досортировываются.
+static std::shared_ptr<Segment> freeze_partials(std::vector<Partial>& partials,
+                                                std::vector<uint32_t> lengths,
+                                                ThreadPool& pool, bool ordered, bool with_positions,
+                                                PostingCodec codec) {
+    const size_t n = lengths.size();
+    std::vector<std::unordered_map<std::string_view, BuildList>> shards(SHARDS);
+    pool.parallel_for(SHARDS, [&](size_t s) {
+        SE_METRIC_TIMER(IndexMergeNs);
+        auto& dict = shards[s];
+        for (auto& part : partials) {
+            for (auto& [word, list] : part.shards[s]) {
+                auto& dst = dict[word];
+                if (dst.entries.empty()) { dst = std::move(list); continue; }
+                dst.entries.insert(dst.entries.end(), list.entries.begin(), list.entries.end());
+                dst.positions.insert(dst.positions.end(), list.positions.begin(), list.positions.end());
+            }
+            part.shards[s].clear();
+        }
+        if (!ordered) {
+            for (auto& [word, list] : dict) sort_list(list);
+        }
+    });
+
+    // замораживаем в компактную раскладку; рабочие словари больше не нужны
+    std::vector<CompactIndex::TermPostings> terms;
+    size_t total = 0;
+    for (const auto& dict : shards) total += dict.size();
+    terms.reserve(total);
+    for (const auto& dict : shards)
+        for (const auto& [word, list] : dict)
+            terms.push_back({ word, &list.entries, with_positions ? &list.positions : nullptr });
+    auto base = std::make_shared<Segment>();
+    {
+        SE_METRIC_TIMER(IndexSortNs);
+        base->index.build(std::move(terms), &pool, codec);
+    }
+    shards.clear();
+    partials.clear();
+    base->docs.resize(n);
+    for (size_t i = 0; i < n; ++i) base->docs[i] = static_cast<uint32_t>(i);
+    base->lengths = std::move(lengths);
+    return base;
+}
+
+void InvertedIndex::publish_base(std::shared_ptr<Segment> base, size_t n) {
+    auto snap = std::make_shared<IndexSnapshot>();
+    if (base) {
+        for (uint32_t len : base->lengths) snap->total_length += len;
+        snap->segments.push_back(SegmentView{ std::move(base), nullptr, 0 });
     }
-    return words;
+    snap->doc_count = n;
+    snap->next_doc_id = n;
+    publish(std::move(snap));
 }
 
 void InvertedIndex::UpdateDocumentBase(const std::vector<std::string>& input_docs) {
-    docs_ = input_docs;
-    freq_dictionary_.clear();
+    WaitForMerges();
+    std::lock_guard<std::mutex> lk(write_mutex_);
+    SE_METRIC_TIMER(IndexBuildNs);
+    ++epoch_;
+    if (keep_documents_) docs_ = input_docs;
+    else docs_.clear();
+
+    const size_t n = input_docs.size();
+    if (n > UINT32_MAX) throw std::runtime_error("too many documents");
+    if (n == 0) { publish_base(nullptr, 0); return; }
+
+    ThreadPool pool(threads_);
+
+    // документы режем на непрерывные диапазоны; каждый диапазон строит
+    // свой частичный индекс, уже разложенный по шардам
+    const size_t chunks = std::min(n, pool.size() * 4);
+    std::vector<Partial> partials(chunks);
+    std::vector<uint32_t> lengths(n);
+
+    const ParseOptions opt{ store_positions_, max_doc_words_, &pool };
+    pool.parallel_for(chunks, [&](size_t c) {
+        const size_t begin = n * c / chunks;
+        const size_t end   = n * (c + 1) / chunks;
+        DocWords dw;
+        for (size_t doc_id = begin; doc_id < end; ++doc_id)
+            lengths[doc_id] = index_document(input_docs[doc_id], doc_id, partials[c], dw, opt);
+    });
+
+    // диапазоны идут по возрастанию doc_id — листы уже отсортированы
+    publish_base(freeze_partials(partials, std::move(lengths), pool, true, store_positions_, codec_), n);
+}
+
+// документ конвейера: файл отображён в память, либо (если не вышло) прочитан
+struct StreamedDocument {
+    size_t doc_id = 0;
+    std::shared_ptr<MappedFile> mapped;
+    std::string text;
+
+    std::string_view view() const {
+        if (mapped) return { reinterpret_cast<const char*>(mapped->data()), mapped->size() };
+        return text;
+    }
+};
+
+static StreamedDocument open_document(size_t doc_id, const std::string& path) {
+    StreamedDocument d;
+    d.doc_id = doc_id;
+    try {
+        d.mapped = std::make_shared<MappedFile>(path);
+        return d;
+    } catch (const std::exception&) {
+        // отображение недоступно — читаем обычным способом
+    }
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+        // документ остаётся в базе пустым, чтобы doc_id совпадали с порядком путей
+        std::cerr << "Cannot read file: " << path << "\n";
+        return d;
+    }
+    d.text.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    return d;
+}
 
-    const size_t n = docs_.size();
-    if (n == 0) return;
+void InvertedIndex::UpdateDocumentBaseFromFiles(const std::vector<std::string>& paths) {
+    WaitForMerges();
+    std::lock_guard<std::mutex> lk(write_mutex_);
+    SE_METRIC_TIMER(IndexBuildNs);
+    ++epoch_;
+    docs_.clear();
 
-    std::mutex mtx;
+    const size_t n = paths.size();
+    if (n > UINT32_MAX) throw std::runtime_error("too many documents");
+    if (n == 0) { publish_base(nullptr, 0); return; }
 
-    // каждый файл индексируется в отдельном потоке
-    std::vector<std::thread> threads;
-    threads.reserve(n);
+    ThreadPool pool(threads_);
+    const size_t workers = pool.size();
 
-    for (size_t doc_id = 0; doc_id < n; ++doc_id) {
-        threads.emplace_back([&, doc_id](){
-            // локальный счётчик слов текущего документа
-            std::unordered_map<std::string, size_t> local;
-            for (const auto& w : tokenize_doc(docs_[doc_id])) ++local[w];
+    // Конвейер: читатель по очереди отображает файлы и кладёт их в очередь
+    // ограниченной длины, воркеры токенизируют и индексируют. Одновременно
+    // в памяти не больше capacity + workers документов.
+    BoundedQueue<StreamedDocument> queue(workers * 2);
+    std::vector<Partial> partials(workers);
+    std::vector<uint32_t> lengths(n);
+    if (keep_documents_) docs_.resize(n);
 
-            // мержим локальные (слово -> {doc_id, count}) в общий словарь
-            std::lock_guard<std::mutex> lk(mtx);
-            for (const auto& [word, cnt] : local) {
-                freq_dictionary_[word].push_back(Entry{ doc_id, cnt });
+    std::thread reader([&]{
+        for (size_t doc_id = 0; doc_id < n; ++doc_id)
+            if (!queue.push(open_document(doc_id, paths[doc_id]))) break;
+        queue.close();
+    });
+
+    std::exception_ptr error;
+    const ParseOptions opt{ store_positions_, max_doc_words_, &pool };
+    try {
+        pool.parallel_for(workers, [&](size_t w) {
+            DocWords dw;
+            StreamedDocument d;
+            while (queue.pop(d)) {
+                if (keep_documents_) docs_[d.doc_id] = std::string(d.view());
+                lengths[d.doc_id] = index_document(d.view(), d.doc_id, partials[w], dw, opt);
+                d = StreamedDocument{}; // отпускаем отображение сразу
             }
         });
+    } catch (...) {
+        error = std::current_exception();
+        queue.close();
     }
+    reader.join();
+    if (error) std::rethrow_exception(error);
+
+    // воркеры брали документы вперемешку — листы нужно досортировать
+    publish_base(freeze_partials(partials, std::move(lengths), pool, false, store_positions_, codec_), n);
+}
+
+// сегмент из одного документа — стоимость пропорциональна его тексту
+static std::shared_ptr<Segment> build_single(size_t doc_id, const std::string& text, bool with_positions,
+                                             size_t max_words, PostingCodec codec) {
+    DocWords dw;
+    const uint32_t length = count_words(text, dw, with_positions, max_words);
 
-    for (auto& t : threads) t.join();
+    std::vector<std::pair<std::string_view, BuildList>> lists;
+    lists.reserve(dw.words.size());
+    for (const auto& [word, slot] : dw.words) {
+        BuildList list;
+        list.entries.push_back(Entry{ doc_id, slot.count });
+        if (with_positions) list.positions.assign(dw.begin(slot), dw.end(slot));
+        lists.emplace_back(word, std::move(list));
+    }
+    std::vector<CompactIndex::TermPostings> terms;
+    terms.reserve(lists.size());
+    for (const auto& [word, list] : lists)
+        terms.push_back({ word, &list.entries, with_positions ? &list.positions : nullptr });
+
+    auto seg = std::make_shared<Segment>();
+    seg->index.build(std::move(terms), nullptr, codec);
+    seg->docs.push_back(static_cast<uint32_t>(doc_id));
+    seg->lengths.push_back(length);
+    return seg;
+}
+
+// копия вида сегмента с ещё одним tombstone
+static SegmentView with_tombstone(const SegmentView& v, size_t doc) {
+    const size_t span = v.segment->docs.back() - v.segment->min_doc() + 1;
+    auto bits = v.deleted ? std::make_shared<std::vector<uint64_t>>(*v.deleted)
+                          : std::make_shared<std::vector<uint64_t>>((span + 63) / 64, 0);
+    const size_t i = doc - v.segment->min_doc();
+    (*bits)[i >> 6] |= uint64_t(1) << (i & 63);
+    return SegmentView{ v.segment, std::move(bits), v.deleted_count + 1 };
+}
+
+// номер сегмента, где документ жив, или npos
+static size_t find_live(const IndexSnapshot& snap, size_t doc) {
+    for (size_t i = snap.segments.size(); i-- > 0;) {
+        const auto& v = snap.segments[i];
+        if (v.segment->contains(doc) && !v.is_deleted(doc)) return i;
+    }
+    return CompactIndex::npos;
+}
 
-    // стабилизируем порядок
-    for (auto& [word, entries] : freq_dictionary_) {
-        std::sort(entries.begin(), entries.end(),
+// снимок без документа doc в сегменте i (пустой сегмент выбрасывается)
+static void tombstone(IndexSnapshot& snap, size_t i, size_t doc) {
+    snap.total_length -= snap.segments[i].segment->length(doc);
+    SegmentView v = with_tombstone(snap.segments[i], doc);
+    if (v.deleted_count == v.segment->docs.size()) snap.segments.erase(snap.segments.begin() + i);
+    else snap.segments[i] = std::move(v);
+}
+
+size_t InvertedIndex::AddDocument(const std::string& text) {
+    size_t id;
+    {
+        std::lock_guard<std::mutex> lk(write_mutex_);
+        auto cur = Snapshot();
+        id = cur->next_doc_id;
+        if (id >= UINT32_MAX) throw std::runtime_error("too many documents");
+        auto snap = std::make_shared<IndexSnapshot>(*cur);
+        auto seg = build_single(id, text, store_positions_, max_doc_words_, codec_);
+        snap->total_length += seg->lengths.front();
+        snap->segments.push_back(SegmentView{ std::move(seg), nullptr, 0 });
+        ++snap->doc_count;
+        ++snap->next_doc_id;
+        publish(std::move(snap));
+    }
+    maybe_start_merge();
+    return id;
+}
+
+bool InvertedIndex::RemoveDocument(size_t doc_id) {
+    std::lock_guard<std::mutex> lk(write_mutex_);
+    auto cur = Snapshot();
+    const size_t i = find_live(*cur, doc_id);
+    if (i == CompactIndex::npos) return false;
+    auto snap = std::make_shared<IndexSnapshot>(*cur);
+    tombstone(*snap, i, doc_id);
+    --snap->doc_count;
+    publish(std::move(snap));
+    return true;
+}
+
+bool InvertedIndex::ReplaceDocument(size_t doc_id, const std::string& text) {
+    {
+        std::lock_guard<std::mutex> lk(write_mutex_);
+        auto cur = Snapshot();
+        const size_t i = find_live(*cur, doc_id);
+        if (i == CompactIndex::npos) return false;
+        auto seg = build_single(doc_id, text, store_positions_, max_doc_words_, codec_);
+        // старая версия и новая публикуются одним снимком
+        auto snap = std::make_shared<IndexSnapshot>(*cur);
+        tombstone(*snap, i, doc_id);
+        snap->total_length += seg->lengths.front();
+        snap->segments.push_back(SegmentView{ std::move(seg), nullptr, 0 });
+        publish(std::move(snap));
+    }
+    maybe_start_merge();
+    return true;
+}
+
+// Слить живые документы нескольких сегментов в один (nullptr — живых нет).
+// Позиции переносятся, если они есть во всех сливаемых сегментах.
+static std::shared_ptr<Segment> merge_views(const std::vector<SegmentView>& views, PostingCodec codec) {
+    std::unordered_map<std::string_view, BuildList> lists;
+    std::vector<std::pair<uint32_t, uint32_t>> docs; // (doc_id, длина)
+    const bool with_positions = std::all_of(views.begin(), views.end(),
+        [](const SegmentView& v){ return v.segment->index.has_positions(); });
+    std::vector<uint32_t> pos;
+    for (const auto& v : views) {
+        const Segment& seg = *v.segment;
+        for (size_t i = 0; i < seg.docs.size(); ++i)
+            if (!v.is_deleted(seg.docs[i])) docs.emplace_back(seg.docs[i], seg.lengths[i]);
+        const CompactIndex& ci = v.segment->index;
+        for (size_t t = 0; t < ci.term_count(); ++t) {
+            auto& dst = lists[ci.term(t)];
+            PositionReader pr = ci.positions(t);
+            for (PostingCursor c = ci.cursor(t); !c.at_end(); c.next()) {
+                if (v.is_deleted(c.doc())) continue;
+                dst.entries.push_back(Entry{ c.doc(), c.count() });
+                if (!with_positions) continue;
+                pr.read(c, pos);
+                dst.positions.insert(dst.positions.end(), pos.begin(), pos.end());
+            }
+        }
+    }
+    if (docs.empty()) return nullptr;
+    std::sort(docs.begin(), docs.end());
+
+    std::vector<CompactIndex::TermPostings> terms;
+    terms.reserve(lists.size());
+    for (auto& [word, list] : lists) {
+        if (list.entries.empty()) continue;
+        sort_list(list);
+        terms.push_back({ word, &list.entries, with_positions ? &list.positions : nullptr });
+    }
+    auto seg = std::make_shared<Segment>();
+    seg->index.build(std::move(terms), nullptr, codec);
+    seg->docs.reserve(docs.size());
+    seg->lengths.reserve(docs.size());
+    for (const auto& [doc, len] : docs) {
+        seg->docs.push_back(doc);
+        seg->lengths.push_back(len);
+    }
+    return seg;
+}
+
+// Собрать снимок, где сегменты picked (взятые из снимка before) заменены на
+// merged. Удаления, случившиеся в cur после before, переносятся в merged.
+static std::shared_ptr<IndexSnapshot> replace_segments(const IndexSnapshot& cur,
+                                                       const std::vector<SegmentView>& picked,
+                                                       std::shared_ptr<Segment> merged) {
+    auto snap = std::make_shared<IndexSnapshot>();
+    snap->doc_count = cur.doc_count;
+    snap->next_doc_id = cur.next_doc_id;
+    snap->total_length = cur.total_length;
+    for (const auto& v : cur.segments) {
+        const bool was_picked = std::any_of(picked.begin(), picked.end(),
+            [&](const SegmentView& p){ return p.segment == v.segment; });
+        if (!was_picked) snap->segments.push_back(v);
+    }
+    if (!merged) return snap;
+
+    SegmentView mv{ std::move(merged), nullptr, 0 };
+    for (const auto& p : picked) {
+        auto it = std::find_if(cur.segments.begin(), cur.segments.end(),
+            [&](const SegmentView& v){ return v.segment == p.segment; });
+        for (uint32_t d : p.segment->docs) {
+            if (p.is_deleted(d)) continue;
+            // сегмент целиком удалён в cur, либо документ удалён после начала слияния
+            if (it == cur.segments.end() || it->is_deleted(d)) mv = with_tombstone(mv, d);
+        }
+    }
+    if (mv.deleted_count < mv.segment->docs.size()) snap->segments.push_back(std::move(mv));
+    return snap;
+}
+
+// Выдача после слияния прежняя, только если сливаемые сегменты без удалений:
+// df слов считается по словарям сегментов вместе с удалёнными документами,
+// а слияние их выбрасывает — веса TF-IDF/BM25 меняются.
+static bool merge_keeps_results(const std::vector<SegmentView>& picked) {
+    return std::all_of(picked.begin(), picked.end(),
+                       [](const SegmentView& v){ return v.deleted_count == 0; });
+}
+
+void InvertedIndex::maybe_start_merge() {
+    if (Snapshot()->segments.size() <= MAX_SEGMENTS) return;
+    std::lock_guard<std::mutex> mk(merge_mutex_);
+    if (merging_) return;
+    if (merge_thread_.joinable()) merge_thread_.join();
+    uint64_t epoch;
+    {
+        std::lock_guard<std::mutex> lk(write_mutex_);
+        epoch = epoch_;
+    }
+    merging_ = true;
+    merge_thread_ = std::thread([this, epoch]{
+        merge_tail(epoch);
+        merging_ = false;
+    });
+}
+
+// Фоновое слияние: крупнейший сегмент не трогаем, остальные сливаем в один.
+// Если удалённых много или мелочь сравнима по размеру с крупнейшим — сливаем всё.
+void InvertedIndex::merge_tail(uint64_t epoch) {
+    auto before = Snapshot();
+    if (before->segments.size() < 2) return;
+
+    size_t largest = 0, small_docs = 0;
+    for (size_t i = 1; i < before->segments.size(); ++i)
+        if (before->segments[i].segment->docs.size() > before->segments[largest].segment->docs.size()) largest = i;
+    for (size_t i = 0; i < before->segments.size(); ++i)
+        if (i != largest) small_docs += before->segments[i].segment->docs.size();
+    const auto& big = before->segments[largest];
+    const bool merge_all = big.deleted_count * 4 > big.segment->docs.size()
+                        || small_docs * 2 > big.segment->docs.size();
+
+    std::vector<SegmentView> picked;
+    for (size_t i = 0; i < before->segments.size(); ++i)
+        if (merge_all || i != largest) picked.push_back(before->segments[i]);
+    auto merged = merge_views(picked, codec_);
+
+    std::lock_guard<std::mutex> lk(write_mutex_);
+    if (epoch_ != epoch) return; // индекс перестроен, результат устарел
+    publish(replace_segments(*Snapshot(), picked, std::move(merged)), merge_keeps_results(picked));
+}
+
+void InvertedIndex::WaitForMerges() {
+    std::lock_guard<std::mutex> mk(merge_mutex_);
+    if (merge_thread_.joinable()) merge_thread_.join();
+}
+
+void InvertedIndex::MergeSegments() {
+    WaitForMerges();
+    std::lock_guard<std::mutex> lk(write_mutex_);
+    auto cur = Snapshot();
+    if (cur->segments.size() == 1 && cur->segments.front().deleted_count == 0) return;
+    publish(replace_segments(*cur, cur->segments, merge_views(cur->segments, codec_)),
+            merge_keeps_results(cur->segments));
+}
+
+std::vector<Entry> InvertedIndex::GetWordCount(const std::string& word) const {
+    auto snap = Snapshot();
+    std::vector<Entry> out;
+    for (const auto& v : snap->segments) {
+        const size_t t = v.segment->index.find(word);
+        if (t == CompactIndex::npos) continue;
+        for (PostingCursor c = v.segment->index.cursor(t); !c.at_end(); c.next())
+            if (!v.is_deleted(c.doc())) out.push_back(Entry{ c.doc(), c.count() });
+    }
+    if (snap->segments.size() > 1) {
+        std::sort(out.begin(), out.end(),
                   [](const Entry& a, const Entry& b){ return a.doc_id < b.doc_id; });
     }
+    return out;
+}
+
+PostingCursor InvertedIndex::GetPostings(std::string_view word) const {
+    auto snap = Snapshot();
+    if (snap->segments.empty()) return {};
+    if (snap->segments.size() > 1 || snap->segments.front().deleted_count)
+        throw std::logic_error("GetPostings needs a single-segment index; use Snapshot()");
+    const CompactIndex& ci = snap->segments.front().segment->index;
+    const size_t t = ci.find(word);
+    if (t == CompactIndex::npos) return {};
+    return ci.cursor(t);
+}
+
+PostingCodec InvertedIndex::parsePostingCodec(const std::string& name) {
+    if (name == "raw")     return PostingCodec::Raw;
+    if (name == "varint")  return PostingCodec::Varint;
+    if (name == "bitpack") return PostingCodec::BitPack;
+    throw std::runtime_error("unknown posting codec: " + name);
+}
+
+size_t InvertedIndex::MemoryUsage() const {
+    size_t bytes = 0;
+    for (const auto& v : Snapshot()->segments) bytes += v.segment->index.memory_usage();
+    return bytes;
 }
 
-std::vector<Entry> InvertedIndex::GetWordCount(const std::string& word) {
-    auto it = freq_dictionary_.find(word);
-    if (it == freq_dictionary_.end()) return {};
-    return it->second; // уже отсортировано по doc_id
+// ---- файл индекса ----
+static constexpr char     INDEX_MAGIC[8] = { 'S', 'E', 'I', 'N', 'D', 'E', 'X', '\0' };
+static constexpr uint32_t INDEX_VERSION  = 6;
+
+struct IndexFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t fingerprint;   // отпечаток конфигурации и исходных файлов
+    uint64_t doc_count;
+    uint64_t image_size;    // за образом идут doc_count значений doc_id и столько же длин (u32)
+    uint64_t checksum;      // по образу и хвосту (doc_id + длины)
+    uint64_t reserved[2];
+};
+static_assert(sizeof(IndexFileHeader) == 64, "index header must stay 64 bytes");
+
+// быстрая некриптографическая сумма по 8-байтовым словам
+static uint64_t checksum64(const uint8_t* p, size_t n) {
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ n;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0x100000001B3ull;
+        h ^= h >> 29;
+    }
+    for (; i < n; ++i) h = (h ^ p[i]) * 0x100000001B3ull;
+    return h ^ (h >> 32);
+}
+
+void InvertedIndex::SaveIndexFile(const std::string& path, uint64_t fingerprint) {
+    MergeSegments();
+    auto snap = Snapshot();
+    CompactIndex empty;
+    const CompactIndex* ci = &empty;
+    // хвост файла: doc_id сегмента, затем их длины
+    std::vector<uint32_t> tail;
+    if (snap->segments.empty()) empty.build({}, nullptr, codec_);
+    else {
+        const Segment& seg = *snap->segments.front().segment;
+        ci = &seg.index;
+        tail.reserve(seg.docs.size() * 2);
+        tail.insert(tail.end(), seg.docs.begin(), seg.docs.end());
+        tail.insert(tail.end(), seg.lengths.begin(), seg.lengths.end());
+    }
+    const size_t tail_bytes = tail.size() * sizeof(uint32_t);
+
+    IndexFileHeader h{};
+    std::memcpy(h.magic, INDEX_MAGIC, sizeof(h.magic));
+    h.version = INDEX_VERSION;
+    h.header_size = sizeof(IndexFileHeader);
+    h.fingerprint = fingerprint;
+    h.doc_count = tail.size() / 2;
+    h.image_size = ci->image_size();
+    h.checksum = checksum64(ci->image(), ci->image_size())
+               ^ (tail_bytes ? checksum64(reinterpret_cast<const uint8_t*>(tail.data()), tail_bytes) : 0);
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        if (!ofs) throw std::runtime_error("Cannot write index file: " + tmp);
+        ofs.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        ofs.write(reinterpret_cast<const char*>(ci->image()), static_cast<std::streamsize>(ci->image_size()));
+        if (tail_bytes) ofs.write(reinterpret_cast<const char*>(tail.data()), static_cast<std::streamsize>(tail_bytes));
+        if (!ofs) throw std::runtime_error("Cannot write index file: " + tmp);
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        throw std::runtime_error("Cannot write index file: " + path);
+    }
+}
+
+bool InvertedIndex::LoadIndexFile(const std::string& path, uint64_t fingerprint, bool verify_checksum) {
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) return false;
+
+    std::shared_ptr<MappedFile> file;
+    try { file = std::make_shared<MappedFile>(path); }
+    catch (const std::exception& e) {
+        std::cerr << "[Index] " << e.what() << "\n";
+        return false;
+    }
+
+    IndexFileHeader h{};
+    if (file->size() < sizeof(h)) return false;
+    std::memcpy(&h, file->data(), sizeof(h));
+    const uint64_t payload = file->size() - sizeof(h);
+    if (std::memcmp(h.magic, INDEX_MAGIC, sizeof(h.magic)) != 0 || h.version != INDEX_VERSION
+        || h.header_size != sizeof(h) || h.image_size > payload || h.doc_count > UINT32_MAX
+        || payload - h.image_size != h.doc_count * 2 * sizeof(uint32_t)) {
+        std::cerr << "[Index] Unsupported or corrupted index file: " << path << "\n";
+        return false;
+    }
+    if (h.fingerprint != fingerprint) return false; // конфигурация или документы изменились
+
+    const uint8_t* image = file->data() + sizeof(h);
+    const size_t image_size = static_cast<size_t>(h.image_size);
+    const uint8_t* docs = image + image_size;
+    const size_t docs_bytes = static_cast<size_t>(h.doc_count) * sizeof(uint32_t);
+    if (verify_checksum && (checksum64(image, image_size) ^ (docs_bytes ? checksum64(docs, 2 * docs_bytes) : 0)) != h.checksum) {
+        std::cerr << "[Index] Checksum mismatch: " << path << "\n";
+        return false;
+    }
+
+    auto seg = std::make_shared<Segment>();
+    try { seg->index.attach(image, image_size, file); }
+    catch (const std::exception& e) {
+        std::cerr << "[Index] " << e.what() << ": " << path << "\n";
+        return false;
+    }
+    seg->docs.resize(static_cast<size_t>(h.doc_count));
+    seg->lengths.resize(static_cast<size_t>(h.doc_count));
+    if (docs_bytes) {
+        std::memcpy(seg->docs.data(), docs, docs_bytes);
+        std::memcpy(seg->lengths.data(), docs + docs_bytes, docs_bytes);
+    }
+
+    auto snap = std::make_shared<IndexSnapshot>();
+    for (uint32_t len : seg->lengths) snap->total_length += len;
+    if (!seg->docs.empty()) {
+        snap->doc_count = seg->docs.size();
+        snap->next_doc_id = size_t(seg->docs.back()) + 1;
+        snap->segments.push_back(SegmentView{ std::move(seg), nullptr, 0 });
+    }
+
+    WaitForMerges();
+    std::lock_guard<std::mutex> lk(write_mutex_);
+    ++epoch_;
+    docs_.clear();
+    publish(std::move(snap));
+    return true;
 }
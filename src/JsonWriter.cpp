@@ -0,0 +1,124 @@
+#include "JsonWriter.h"
+#include <nlohmann/json.hpp>
+#include <array>
+#include <charconv>
+#include <cmath>
+
+JsonWriter::JsonWriter(std::ostream& out, int indent) : out_(out), indent_(indent) {
+    buf_.reserve(FLUSH_AT + 4096);
+}
+
+JsonWriter::~JsonWriter() {
+    flush();
+}
+
+void JsonWriter::flush() {
+    if (buf_.empty()) return;
+    out_.write(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+    buf_.clear();
+}
+
+void JsonWriter::newline(size_t depth) {
+    buf_ += '\n';
+    buf_.append(depth * static_cast<size_t>(indent_), ' ');
+}
+
+// разделитель и отступ перед очередным элементом контейнера (значение после ключа — без них)
+void JsonWriter::before_value() {
+    if (after_key_) { after_key_ = false; return; }
+    if (counts_.empty()) return;
+    if (counts_.back()++) buf_ += ',';
+    if (indent_ >= 0) newline(counts_.size());
+    if (buf_.size() >= FLUSH_AT) flush();
+}
+
+void JsonWriter::open(char c) {
+    before_value();
+    buf_ += c;
+    counts_.push_back(0);
+}
+
+// пустой контейнер закрывается сразу ("{}", "[]"), непустой — с новой строки
+void JsonWriter::close(char c) {
+    const size_t n = counts_.back();
+    counts_.pop_back();
+    if (n && indent_ >= 0) newline(counts_.size());
+    buf_ += c;
+}
+
+void JsonWriter::beginObject() { open('{'); }
+void JsonWriter::endObject()   { close('}'); }
+void JsonWriter::beginArray()  { open('['); }
+void JsonWriter::endArray()    { close(']'); }
+
+void JsonWriter::key(std::string_view k) {
+    before_value();
+    put_string(k);
+    buf_ += indent_ >= 0 ? ": " : ":";
+    after_key_ = true;
+}
+
+// экранирование как у nlohmann (ensure_ascii = false): UTF-8 пишется как есть
+void JsonWriter::put_string(std::string_view s) {
+    static const char HEX[] = "0123456789abcdef";
+    buf_ += '"';
+    for (const char ch : s) {
+        const auto c = static_cast<unsigned char>(ch);
+        switch (c) {
+        case '"':  buf_ += "\\\""; break;
+        case '\\': buf_ += "\\\\"; break;
+        case '\b': buf_ += "\\b"; break;
+        case '\f': buf_ += "\\f"; break;
+        case '\n': buf_ += "\\n"; break;
+        case '\r': buf_ += "\\r"; break;
+        case '\t': buf_ += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                buf_ += "\\u00";
+                buf_ += HEX[c >> 4];
+                buf_ += HEX[c & 15];
+            } else {
+                buf_ += ch;
+            }
+        }
+    }
+    buf_ += '"';
+}
+
+void JsonWriter::value(std::string_view s) {
+    before_value();
+    put_string(s);
+}
+
+void JsonWriter::value(int64_t v) {
+    before_value();
+    char tmp[24];
+    const auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    buf_.append(tmp, r.ptr);
+}
+
+void JsonWriter::value(uint64_t v) {
+    before_value();
+    char tmp[24];
+    const auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    buf_.append(tmp, r.ptr);
+}
+
+void JsonWriter::value(double v) {
+    before_value();
+    if (!std::isfinite(v)) { buf_ += "null"; return; }
+    // тот же алгоритм (Grisu2), что в сериализаторе nlohmann — иначе цифры могли бы отличаться
+    std::array<char, 64> tmp;
+    char* end = nlohmann::detail::to_chars(tmp.data(), tmp.data() + tmp.size(), v);
+    buf_.append(tmp.data(), end);
+}
+
+void JsonWriter::value(bool v) {
+    before_value();
+    buf_ += v ? "true" : "false";
+}
+
+void JsonWriter::null() {
+    before_value();
+    buf_ += "null";
+}
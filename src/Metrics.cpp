@@ -0,0 +1,225 @@
+#include "Metrics.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+using json = nlohmann::json;
+
+static constexpr size_t COUNTERS   = static_cast<size_t>(Metrics::Counter::COUNT);
+static constexpr size_t HISTOGRAMS = static_cast<size_t>(Metrics::Histogram::COUNT);
+static constexpr size_t BUCKETS    = 65; // корзина i: значения < 2^i (0 — только ноль)
+
+static const char* const COUNTER_NAMES[] = {
+    "index_documents_total",
+    "index_documents_truncated_total",
+    "search_queries_total",
+    "search_queries_truncated_total",
+    "search_cache_hits_total",
+    "search_postings_total",
+    "search_bytes_read_total",
+    "search_dense_segments_total",
+};
+
+static const char* const HISTOGRAM_NAMES[] = {
+    "index_build_ns",
+    "index_tokenize_ns",
+    "index_merge_ns",
+    "index_sort_ns",
+    "search_query_ns",
+    "search_lookup_ns",
+    "search_intersect_ns",
+    "search_topk_ns",
+    "search_postings_per_query",
+    "search_bytes_per_query",
+};
+static_assert(sizeof(COUNTER_NAMES) / sizeof(*COUNTER_NAMES) == COUNTERS, "COUNTER_NAMES");
+static_assert(sizeof(HISTOGRAM_NAMES) / sizeof(*HISTOGRAM_NAMES) == HISTOGRAMS, "HISTOGRAM_NAMES");
+
+// сложенные значения всех потоков
+struct Totals {
+    uint64_t counters[COUNTERS] = {};
+    uint64_t buckets[HISTOGRAMS][BUCKETS] = {};
+    uint64_t sums[HISTOGRAMS] = {};
+
+    void subtract(const Totals& o) {
+        for (size_t i = 0; i < COUNTERS; ++i) counters[i] -= o.counters[i];
+        for (size_t h = 0; h < HISTOGRAMS; ++h) {
+            sums[h] -= o.sums[h];
+            for (size_t b = 0; b < BUCKETS; ++b) buckets[h][b] -= o.buckets[h][b];
+        }
+    }
+};
+
+// Слот одного потока. Пишет только владелец (load + store, без lock-префикса),
+// читает снимок из любого потока — поэтому atomic с relaxed.
+struct ThreadSlot {
+    std::atomic<uint64_t> counters[COUNTERS] = {};
+    std::atomic<uint64_t> buckets[HISTOGRAMS][BUCKETS] = {};
+    std::atomic<uint64_t> sums[HISTOGRAMS] = {};
+
+    void add_to(Totals& t) const {
+        for (size_t i = 0; i < COUNTERS; ++i) t.counters[i] += counters[i].load(std::memory_order_relaxed);
+        for (size_t h = 0; h < HISTOGRAMS; ++h) {
+            t.sums[h] += sums[h].load(std::memory_order_relaxed);
+            for (size_t b = 0; b < BUCKETS; ++b) t.buckets[h][b] += buckets[h][b].load(std::memory_order_relaxed);
+        }
+    }
+};
+
+struct Registry {
+    std::mutex m;
+    std::vector<const ThreadSlot*> live;
+    Totals retired;   // слоты завершившихся потоков
+    Totals baseline;  // значения на момент reset()
+};
+
+// не разрушается: потоки могут завершаться после выхода из main
+static Registry& registry() {
+    static Registry* r = new Registry;
+    return *r;
+}
+
+// слот регистрируется при первом обращении потока и сдаёт значения при его завершении
+struct SlotHolder {
+    ThreadSlot slot;
+
+    SlotHolder() {
+        std::lock_guard<std::mutex> lk(registry().m);
+        registry().live.push_back(&slot);
+    }
+    ~SlotHolder() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lk(r.m);
+        slot.add_to(r.retired);
+        r.live.erase(std::find(r.live.begin(), r.live.end(), &slot));
+    }
+};
+
+static ThreadSlot& local() {
+    thread_local SlotHolder holder;
+    return holder.slot;
+}
+
+static void bump(std::atomic<uint64_t>& v, uint64_t d) {
+    v.store(v.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+}
+
+// номер корзины — число значащих бит
+static size_t bucket_of(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return v ? 64 - static_cast<size_t>(__builtin_clzll(v)) : 0;
+#else
+    size_t b = 0;
+    while (v) { v >>= 1; ++b; }
+    return b;
+#endif
+}
+
+// верхняя граница корзины (включительно)
+static uint64_t bucket_le(size_t b) {
+    return b == 0 ? 0 : (b >= 64 ? UINT64_MAX : (uint64_t(1) << b) - 1);
+}
+
+void Metrics::add(Counter c, uint64_t v) {
+    bump(local().counters[static_cast<size_t>(c)], v);
+}
+
+void Metrics::observe(Histogram h, uint64_t v) {
+    ThreadSlot& s = local();
+    const size_t i = static_cast<size_t>(h);
+    bump(s.buckets[i][bucket_of(v)], 1);
+    bump(s.sums[i], v);
+}
+
+uint64_t Metrics::now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+bool Metrics::enabled() {
+#if SEARCH_ENGINE_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+static Totals collect() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.m);
+    Totals t = r.retired;
+    for (const ThreadSlot* s : r.live) s->add_to(t);
+    t.subtract(r.baseline);
+    return t;
+}
+
+void Metrics::reset() {
+    Totals t = collect();
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.m);
+    for (size_t i = 0; i < COUNTERS; ++i) r.baseline.counters[i] += t.counters[i];
+    for (size_t h = 0; h < HISTOGRAMS; ++h) {
+        r.baseline.sums[h] += t.sums[h];
+        for (size_t b = 0; b < BUCKETS; ++b) r.baseline.buckets[h][b] += t.buckets[h][b];
+    }
+}
+
+// оценка перцентиля сверху: граница корзины, где набирается доля p
+static uint64_t percentile(const uint64_t* buckets, uint64_t count, double p) {
+    if (count == 0) return 0;
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * static_cast<double>(count) + 0.5));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < BUCKETS; ++b) {
+        seen += buckets[b];
+        if (seen >= rank) return bucket_le(b);
+    }
+    return bucket_le(BUCKETS - 1);
+}
+
+std::string Metrics::toJson() {
+    const Totals t = collect();
+    json out;
+    out["enabled"] = enabled();
+    for (size_t i = 0; i < COUNTERS; ++i) out["counters"][COUNTER_NAMES[i]] = t.counters[i];
+    for (size_t h = 0; h < HISTOGRAMS; ++h) {
+        uint64_t count = 0;
+        for (size_t b = 0; b < BUCKETS; ++b) count += t.buckets[h][b];
+        json& j = out["histograms"][HISTOGRAM_NAMES[h]];
+        j["count"] = count;
+        j["sum"] = t.sums[h];
+        j["p50"] = percentile(t.buckets[h], count, 0.50);
+        j["p99"] = percentile(t.buckets[h], count, 0.99);
+    }
+    return out.dump();
+}
+
+std::string Metrics::toPrometheus() {
+    const Totals t = collect();
+    std::ostringstream os;
+    for (size_t i = 0; i < COUNTERS; ++i) {
+        os << "# TYPE search_engine_" << COUNTER_NAMES[i] << " counter\n"
+           << "search_engine_" << COUNTER_NAMES[i] << ' ' << t.counters[i] << '\n';
+    }
+    for (size_t h = 0; h < HISTOGRAMS; ++h) {
+        const std::string name = std::string("search_engine_") + HISTOGRAM_NAMES[h];
+        os << "# TYPE " << name << " histogram\n";
+        // корзины до последней непустой, дальше только +Inf
+        size_t last = 0;
+        for (size_t b = 0; b < BUCKETS; ++b) if (t.buckets[h][b]) last = b;
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b <= last && b < 64; ++b) {
+            cumulative += t.buckets[h][b];
+            os << name << "_bucket{le=\"" << bucket_le(b) << "\"} " << cumulative << '\n';
+        }
+        uint64_t count = 0;
+        for (size_t b = 0; b < BUCKETS; ++b) count += t.buckets[h][b];
+        os << name << "_bucket{le=\"+Inf\"} " << count << '\n'
+           << name << "_sum " << t.sums[h] << '\n'
+           << name << "_count " << count << '\n';
+    }
+    return os.str();
+}
@@ -0,0 +1,196 @@
+#include "PostingCursor.h"
+#include <algorithm>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static uint32_t load_u32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static const uint8_t* get_varint(const uint8_t* p, uint32_t& v) {
+    uint32_t r = 0;
+    int shift = 0;
+    while (*p & 0x80) { r |= uint32_t(*p++ & 0x7F) << shift; shift += 7; }
+    v = r | (uint32_t(*p++) << shift);
+    return p;
+}
+
+// Распаковать BLOCK значений шириной bits из раскладки SIMD-BP128: bits
+// 128-битных слов, значение i — в дорожке i % 4, четвёрки идут подряд по битам
+// дорожки. Возвращает конец упакованных данных.
+static const uint8_t* unpack_block(const uint8_t* in, uint32_t bits, uint32_t* out) {
+    constexpr uint32_t GROUPS = PostingCursor::BLOCK / 4;
+    if (bits == 0) {
+        std::fill(out, out + PostingCursor::BLOCK, 0u);
+        return in;
+    }
+    const uint32_t mask = bits == 32 ? UINT32_MAX : (1u << bits) - 1;
+#if defined(__SSE2__)
+    const __m128i m = _mm_set1_epi32(static_cast<int>(mask));
+    __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    uint32_t loaded = 1, shift = 0;
+    for (uint32_t k = 0; k < GROUPS; ++k) {
+        __m128i v = _mm_srl_epi32(cur, _mm_cvtsi32_si128(static_cast<int>(shift)));
+        shift += bits;
+        if (shift >= 32) {
+            shift -= 32;
+            if (loaded < bits) {
+                cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16 * loaded++));
+                // значение переходит в следующее слово — добираем старшие биты
+                if (shift) v = _mm_or_si128(v, _mm_sll_epi32(cur, _mm_cvtsi32_si128(static_cast<int>(bits - shift))));
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * k), _mm_and_si128(v, m));
+    }
+#else
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+        for (uint32_t k = 0; k < GROUPS; ++k) {
+            const uint32_t bit = k * bits, word = bit / 32, off = bit % 32;
+            uint64_t v = load_u32(in + 16 * word + 4 * lane) >> off;
+            if (off + bits > 32) v |= uint64_t(load_u32(in + 16 * (word + 1) + 4 * lane)) << (32 - off);
+            out[4 * k + lane] = static_cast<uint32_t>(v) & mask;
+        }
+    }
+#endif
+    return in + 16 * size_t(bits);
+}
+
+PostingCursor::PostingCursor(const uint8_t* data, uint32_t size, uint32_t max_count, PostingCodec codec)
+    : size_(size), max_count_(max_count), codec_(codec) {
+    if (size == 0) return;
+    nblocks_ = (size + BLOCK - 1) / BLOCK;
+    if (nblocks_ > 1) {
+        skips_ = data;
+        blocks_ = data + size_t(nblocks_) * SKIP_ENTRY;
+    } else {
+        blocks_ = data;
+    }
+    end_ = false;
+    load_block(0);
+    if (nblocks_ == 1) last_doc_ = docs_[len_ - 1];
+}
+
+uint32_t PostingCursor::skip_field(uint32_t b, uint32_t f) const {
+    return load_u32(skips_ + size_t(b) * SKIP_ENTRY + f * 4);
+}
+
+void PostingCursor::load_block(uint32_t b) {
+    block_ = b;
+    pos_ = 0;
+    len_ = std::min(BLOCK, size_ - b * BLOCK);
+    const uint8_t* const start = blocks_ + (b ? skip_field(b - 1, 1) : 0);
+    const uint8_t* p = start;
+    uint32_t doc = b ? skip_field(b - 1, 0) : 0;
+    switch (codec_) {
+    case PostingCodec::Raw:
+        std::memcpy(docs_, p, len_ * sizeof(uint32_t));
+        std::memcpy(counts_, p + len_ * sizeof(uint32_t), len_ * sizeof(uint32_t));
+        p += len_ * 2 * sizeof(uint32_t);
+        break;
+    case PostingCodec::BitPack:
+        if (len_ == BLOCK) {
+            const uint32_t doc_bits = p[0], count_bits = p[1];
+            p = unpack_block(p + 2, doc_bits, docs_);
+            p = unpack_block(p, count_bits, counts_);
+            for (uint32_t i = 0; i < BLOCK; ++i) {
+                doc += docs_[i];
+                docs_[i] = doc;
+                counts_[i] += 1;
+            }
+            break;
+        }
+        [[fallthrough]];
+    case PostingCodec::Varint:
+        for (uint32_t i = 0; i < len_; ++i) {
+            uint32_t delta;
+            p = get_varint(p, delta);
+            p = get_varint(p, counts_[i]);
+            doc += delta;
+            docs_[i] = doc;
+        }
+        break;
+    }
+    bytes_read_ += static_cast<size_t>(p - start);
+}
+
+uint32_t PostingCursor::find_block(size_t target) const {
+    if (nblocks_ == 0) return 0;
+    if (block_last_doc(block_) >= target) return block_;
+    if (block_last_doc(nblocks_ - 1) < target) return nblocks_;
+    // галоп по таблице пропусков, затем бинарный поиск
+    uint32_t lo = block_ + 1, step = 1, hi = lo;
+    while (hi < nblocks_ && block_last_doc(hi) < target) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    hi = std::min(hi, nblocks_ - 1);
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (block_last_doc(mid) < target) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+bool PostingCursor::seek(size_t target) {
+    // нужный doc_id за пределами текущего блока — переходим по таблице пропусков
+    if (docs_[len_ - 1] < target) {
+        const uint32_t b = find_block(target);
+        if (b >= nblocks_) {
+            pos_ = len_ - 1;
+            end_ = true;
+            return false;
+        }
+        load_block(b);
+    }
+
+    // внутри блока — галоп от текущей позиции, затем бинарный поиск
+    uint32_t lo = pos_, step = 1, hi = pos_;
+    while (hi < len_ && docs_[hi] < target) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    hi = std::min(hi, len_);
+    pos_ = static_cast<uint32_t>(std::lower_bound(docs_ + lo, docs_ + hi, static_cast<uint32_t>(target)) - docs_);
+    return true;
+}
+
+PositionReader::PositionReader(const uint8_t* data, uint32_t size) {
+    if (size == 0) return;
+    const uint32_t nblocks = (size + PostingCursor::BLOCK - 1) / PostingCursor::BLOCK;
+    if (nblocks > 1) {
+        table_ = data;
+        data_ = data + size_t(nblocks) * 4;
+    } else {
+        data_ = data;
+    }
+    p_ = data_;
+}
+
+void PositionReader::read(const PostingCursor& c, std::vector<uint32_t>& out) {
+    if (c.block() != block_) {
+        block_ = c.block();
+        pos_ = 0;
+        p_ = data_ + load_u32(table_ + size_t(block_) * 4);
+    }
+    // позиции пропущенных posting пропускаем, не декодируя: varint кончается байтом без старшего бита
+    const uint32_t* counts = c.block_counts();
+    for (; pos_ < c.block_pos(); ++pos_)
+        for (uint32_t k = 0; k < counts[pos_]; ++k) while (*p_++ & 0x80) {}
+
+    out.resize(counts[pos_]);
+    uint32_t v = 0;
+    for (uint32_t k = 0; k < counts[pos_]; ++k) {
+        uint32_t delta;
+        p_ = get_varint(p_, delta);
+        v += delta;
+        out[k] = v;
+    }
+    ++pos_;
+}
@@ -0,0 +1,104 @@
+#include "QueryCache.h"
+#include "SearchServer.h"
+#include <functional>
+
+// примерная стоимость записи сверх ключа и результатов: узел списка, узел
+// хеш-таблицы и копия ключа в нём
+static constexpr size_t ITEM_OVERHEAD = 128;
+
+static size_t item_bytes(const std::string& key, size_t results) {
+    return 2 * key.size() + results * sizeof(RelativeIndex) + ITEM_OVERHEAD;
+}
+
+QueryCache::QueryCache(size_t capacity_bytes)
+    : capacity_(capacity_bytes), shards_(new Shard[SHARDS]) {}
+
+void QueryCache::setCapacity(size_t capacity_bytes) {
+    capacity_ = capacity_bytes;
+    for (size_t i = 0; i < SHARDS; ++i) {
+        std::lock_guard<std::mutex> lk(shards_[i].m);
+        evict(shards_[i], capacity_ / SHARDS);
+    }
+}
+
+QueryCache::Shard& QueryCache::shard_of(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % SHARDS];
+}
+
+// вытеснить самые старые записи, пока шард не уложится в бюджет
+void QueryCache::evict(Shard& s, size_t budget) {
+    while (s.bytes > budget && !s.lru.empty()) {
+        s.bytes -= s.lru.back().bytes;
+        s.map.erase(s.lru.back().key);
+        s.lru.pop_back();
+    }
+}
+
+bool QueryCache::get(const std::string& key, uint64_t generation, std::vector<RelativeIndex>& out) {
+    if (!enabled()) return false;
+    Shard& s = shard_of(key);
+    {
+        std::lock_guard<std::mutex> lk(s.m);
+        auto it = s.map.find(key);
+        if (it != s.map.end()) {
+            if (it->second->generation == generation) {
+                s.lru.splice(s.lru.begin(), s.lru, it->second);
+                out = it->second->value;
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            // посчитано на старом поколении индекса — запись устарела
+            // (если на более новом — спрашивает читатель со старым снимком, не трогаем)
+            if (it->second->generation < generation) {
+                s.bytes -= it->second->bytes;
+                s.lru.erase(it->second);
+                s.map.erase(it);
+            }
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void QueryCache::put(const std::string& key, uint64_t generation, const std::vector<RelativeIndex>& value) {
+    if (!enabled()) return;
+    const size_t budget = capacity_ / SHARDS;
+    const size_t bytes = item_bytes(key, value.size());
+    if (bytes > budget) return;
+
+    Shard& s = shard_of(key);
+    std::lock_guard<std::mutex> lk(s.m);
+    auto it = s.map.find(key);
+    if (it != s.map.end()) {
+        // поколения только растут: старший результат не затираем младшим
+        if (it->second->generation > generation) return;
+        s.bytes -= it->second->bytes;
+        s.lru.erase(it->second);
+        s.map.erase(it);
+    }
+    s.lru.push_front(Item{ key, generation, value, bytes });
+    s.map.emplace(key, s.lru.begin());
+    s.bytes += bytes;
+    evict(s, budget);
+}
+
+void QueryCache::clear() {
+    for (size_t i = 0; i < SHARDS; ++i) {
+        std::lock_guard<std::mutex> lk(shards_[i].m);
+        shards_[i].lru.clear();
+        shards_[i].map.clear();
+        shards_[i].bytes = 0;
+    }
+}
+
+QueryCache::Stats QueryCache::stats() const {
+    Stats st;
+    st.hits = hits_.load(std::memory_order_relaxed);
+    st.misses = misses_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < SHARDS; ++i) {
+        std::lock_guard<std::mutex> lk(shards_[i].m);
+        st.entries += shards_[i].map.size();
+        st.bytes += shards_[i].bytes;
+    }
+    return st;
+}
@@ -0,0 +1,445 @@
+#include "QueryServer.h"
+#include "Metrics.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+static constexpr size_t MAX_LINE       = 1 << 20; // строка запроса длиннее — ошибка протокола
+static constexpr size_t LATENCY_WINDOW = 4096;    // сколько последних задержек держим для перцентилей
+static constexpr int    MAX_LIMIT      = 10000;   // "limit" больше — ошибка (поиск резервирует память под limit ответов)
+
+std::string QueryServer::handle(const std::string& line) {
+    const auto start = std::chrono::steady_clock::now();
+    json id;
+    json reply;
+    bool error = false;
+    try {
+        const json req = json::parse(line);
+        std::string query;
+        size_t limit = static_cast<size_t>(search_.responsesLimit());
+        bool raw = false;
+        bool query_stats = false;
+        QueryStats global;
+        bool has_global = false;
+        SearchServer::Match match = search_.match();
+        size_t min_should_match = search_.minShouldMatch();
+        if (req.is_string()) {
+            query = req.get<std::string>();
+        } else if (req.is_object()) {
+            if (req.contains("id")) id = req["id"];
+            if (req.contains("cmd")) {
+                if (req["cmd"] == "stats") return stats_json();
+                if (req["cmd"] == "metrics") {
+                    if (req.value("format", "json") == "prometheus")
+                        return json{ {"prometheus", Metrics::toPrometheus()} }.dump();
+                    return Metrics::toJson();
+                }
+                throw std::runtime_error("unknown cmd");
+            }
+            if (!req.contains("query") || !req["query"].is_string())
+                throw std::runtime_error("missing \"query\"");
+            query = req["query"].get<std::string>();
+            raw = req.value("raw", false);
+            query_stats = req.value("query_stats", false);
+            if (req.contains("global_stats")) {
+                const json& g = req["global_stats"];
+                global.doc_count = g.at("doc_count").get<size_t>();
+                global.total_length = g.at("total_length").get<uint64_t>();
+                global.df = g.at("df").get<std::vector<size_t>>();
+                has_global = true;
+            }
+            if (req.contains("limit")) {
+                const int l = req["limit"].get<int>();
+                if (l <= 0) throw std::runtime_error("\"limit\" must be positive");
+                if (l > MAX_LIMIT)
+                    throw std::runtime_error("\"limit\" must not exceed " + std::to_string(MAX_LIMIT));
+                limit = static_cast<size_t>(l);
+            }
+            if (req.contains("match")) match = SearchServer::parseMatch(req["match"].get<std::string>());
+            if (req.contains("min_should_match")) {
+                const int m = req["min_should_match"].get<int>();
+                if (m <= 0) throw std::runtime_error("\"min_should_match\" must be positive");
+                min_should_match = static_cast<size_t>(m);
+            }
+        } else {
+            throw std::runtime_error("request must be a string or an object");
+        }
+
+        if (!id.is_null()) reply["id"] = id;
+        if (query_stats) {
+            // первый проход координатора шардов: статистика корпуса для слов запроса
+            const QueryStats st = search_.queryStats(query);
+            reply["doc_count"] = st.doc_count;
+            reply["total_length"] = st.total_length;
+            reply["df"] = st.df;
+        } else {
+            auto ranked = search_.searchRaw(query, limit, match, min_should_match,
+                                            has_global ? &global : nullptr);
+            if (!raw) SearchServer::normalize(ranked);
+            json rel = json::array();
+            for (const auto& r : ranked)
+                rel.push_back({ {"docid", r.doc_id + doc_offset_}, {"rank", r.rank} });
+            reply["relevance"] = std::move(rel);
+        }
+    } catch (const std::exception& e) {
+        error = true;
+        reply = json::object();
+        if (!id.is_null()) reply["id"] = id;
+        reply["error"] = e.what();
+    }
+
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    const uint32_t latency = static_cast<uint32_t>(std::min<long long>(us, UINT32_MAX));
+    record_latency(latency, error);
+    if (!error) reply["latency_us"] = latency;
+    return reply.dump();
+}
+
+void QueryServer::record_latency(uint32_t us, bool error) {
+    std::lock_guard<std::mutex> lk(stats_m_);
+    ++queries_;
+    if (error) ++errors_;
+    max_us_ = std::max(max_us_, us);
+    if (recent_us_.size() < LATENCY_WINDOW) recent_us_.push_back(us);
+    else recent_us_[recent_pos_] = us;
+    recent_pos_ = (recent_pos_ + 1) % LATENCY_WINDOW;
+}
+
+std::string QueryServer::stats_json() {
+    std::vector<uint32_t> sample;
+    json out;
+    {
+        std::lock_guard<std::mutex> lk(stats_m_);
+        sample = recent_us_;
+        out["queries"] = queries_;
+        out["errors"] = errors_;
+        out["latency_us"]["max"] = max_us_;
+    }
+    // перцентили по окну последних запросов
+    auto pct = [&](double p) -> uint32_t {
+        if (sample.empty()) return 0;
+        const size_t k = std::min(sample.size() - 1, static_cast<size_t>(p * sample.size()));
+        std::nth_element(sample.begin(), sample.begin() + k, sample.end());
+        return sample[k];
+    };
+    const auto cache = search_.cacheStats();
+    out["cache"]["hits"] = cache.hits;
+    out["cache"]["misses"] = cache.misses;
+    out["latency_us"]["p50"] = pct(0.50);
+    out["latency_us"]["p99"] = pct(0.99);
+    return out.dump();
+}
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static constexpr uint64_t LISTEN_ID = 0;
+static constexpr uint64_t WAKE_ID   = 1;
+
+static std::runtime_error sys_error(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+static void set_nonblocking(int fd) {
+    const int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) throw sys_error("fcntl");
+}
+
+// Сокет, оставшийся от прошлого запуска, удаляется; всё остальное по этому
+// пути (обычный файл, сокет живого сервера) — ошибка, а не повод удалить.
+static void remove_stale_socket(const std::string& path, const sockaddr_un& addr) {
+    struct stat st{};
+    if (::lstat(path.c_str(), &st) < 0) {
+        if (errno == ENOENT) return;
+        throw sys_error("stat " + path);
+    }
+    if (!S_ISSOCK(st.st_mode)) throw std::runtime_error(path + " exists and is not a socket");
+    const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) throw sys_error("socket");
+    const int rc = connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    const int err = errno;
+    ::close(probe);
+    if (rc == 0) throw std::runtime_error(path + " is in use by another server");
+    if (err != ECONNREFUSED) {
+        errno = err;
+        throw sys_error("connect " + path);
+    }
+    if (::unlink(path.c_str()) < 0) throw sys_error("unlink " + path);
+}
+
+static void epoll_set(int epfd, int op, int fd, uint32_t events, uint64_t id) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = id;
+    if (epoll_ctl(epfd, op, fd, &ev) < 0) throw sys_error("epoll_ctl");
+}
+
+QueryServer::QueryServer(const SearchServer& search, size_t threads)
+    : search_(search), pool_(std::make_unique<ThreadPool>(threads)) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) throw sys_error("epoll_create1");
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        ::close(epoll_fd_);
+        throw sys_error("eventfd");
+    }
+    epoll_set(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, EPOLLIN, WAKE_ID);
+}
+
+QueryServer::~QueryServer() {
+    // сначала дожидаемся воркеров: они пишут в done_ и будят цикл через wake_fd_
+    pool_.reset();
+    for (auto& [id, c] : conns_) ::close(c.fd);
+    if (listen_fd_ >= 0) ::close(listen_fd_);
+    if (!unix_path_.empty()) ::unlink(unix_path_.c_str());
+    ::close(wake_fd_);
+    ::close(epoll_fd_);
+}
+
+void QueryServer::listen(const std::string& address) {
+    if (listen_fd_ >= 0) throw std::runtime_error("QueryServer is already listening");
+    int fd = -1;
+    if (address.rfind("unix:", 0) == 0) {
+        const std::string path = address.substr(5);
+        sockaddr_un addr{};
+        if (path.empty() || path.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("Bad unix socket path: " + path);
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        remove_stale_socket(path, addr);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw sys_error("socket");
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            ::close(fd);
+            throw sys_error("bind " + path);
+        }
+        unix_path_ = path;
+    } else if (address.rfind("tcp:", 0) == 0) {
+        int port = 0;
+        try { port = std::stoi(address.substr(4)); }
+        catch (...) { port = -1; }
+        if (port < 0 || port > 65535) throw std::runtime_error("Bad tcp port: " + address);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw sys_error("socket");
+        const int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            ::close(fd);
+            throw sys_error("bind " + address);
+        }
+    } else {
+        throw std::runtime_error("Unknown address (expected unix:PATH or tcp:PORT): " + address);
+    }
+
+    if (::listen(fd, SOMAXCONN) < 0) {
+        ::close(fd);
+        throw sys_error("listen");
+    }
+    set_nonblocking(fd);
+    listen_fd_ = fd;
+    epoll_set(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, EPOLLIN, LISTEN_ID);
+}
+
+void QueryServer::stop() {
+    stopping_.store(true);
+    const uint64_t one = 1;
+    // write допустим в обработчике сигнала; переполнение счётчика не страшно
+    [[maybe_unused]] const auto n = ::write(wake_fd_, &one, sizeof(one));
+}
+
+void QueryServer::run() {
+    if (listen_fd_ < 0) throw std::runtime_error("QueryServer::listen was not called");
+    epoll_event events[64];
+    while (!stopping_.load()) {
+        const int n = epoll_wait(epoll_fd_, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw sys_error("epoll_wait");
+        }
+        for (int i = 0; i < n; ++i) {
+            const uint64_t id = events[i].data.u64;
+            if (id == LISTEN_ID) {
+                accept_all();
+            } else if (id == WAKE_ID) {
+                uint64_t cnt;
+                while (::read(wake_fd_, &cnt, sizeof(cnt)) > 0) {}
+                drain_completions();
+            } else {
+                // после EOF читать нечего: соединение ждёт только записи (flush)
+                const auto c = conns_.find(id);
+                if (c == conns_.end()) continue;
+                if (!c->second.eof && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) read_from(id);
+                else if ((events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) && conns_.count(id)) flush(id);
+            }
+        }
+    }
+}
+
+void QueryServer::accept_all() {
+    for (;;) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return; // EAGAIN или временная ошибка (EMFILE и т.п.) — попробуем позже
+        }
+        const uint64_t id = next_conn_id_++;
+        Connection c;
+        c.fd = fd;
+        c.events = EPOLLIN | EPOLLRDHUP;
+        epoll_set(epoll_fd_, EPOLL_CTL_ADD, fd, c.events, id);
+        conns_.emplace(id, std::move(c));
+    }
+}
+
+void QueryServer::read_from(uint64_t id) {
+    auto it = conns_.find(id);
+    if (it == conns_.end()) return;
+    Connection& c = it->second;
+
+    char buf[16384];
+    for (;;) {
+        const ssize_t got = ::recv(c.fd, buf, sizeof(buf), 0);
+        if (got > 0) { c.in.append(buf, static_cast<size_t>(got)); continue; }
+        if (got == 0) { c.eof = true; break; }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        close_connection(id);
+        return;
+    }
+
+    // каждую полную строку — воркеру; ответ вернётся через done_
+    size_t pos = 0;
+    for (;;) {
+        const size_t nl = c.in.find('\n', pos);
+        if (nl == std::string::npos) break;
+        std::string line = c.in.substr(pos, nl - pos);
+        pos = nl + 1;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        const uint64_t seq = c.next_seq++;
+        pool_->submit([this, id, seq, line = std::move(line)]{
+            std::string response = handle(line);
+            {
+                std::lock_guard<std::mutex> lk(done_m_);
+                done_.push_back(Completion{ id, seq, std::move(response) });
+            }
+            const uint64_t one = 1;
+            [[maybe_unused]] const auto n = ::write(wake_fd_, &one, sizeof(one));
+        });
+    }
+    c.in.erase(0, pos);
+
+    if (c.in.size() > MAX_LINE) {
+        // строка без конца — клиент нарушает протокол
+        c.ready.emplace(c.next_seq++, json{ {"error", "request line too long"} }.dump());
+        c.in.clear();
+        c.eof = true;
+    }
+    flush(id);
+}
+
+void QueryServer::drain_completions() {
+    std::vector<Completion> done;
+    {
+        std::lock_guard<std::mutex> lk(done_m_);
+        done.swap(done_);
+    }
+    for (auto& d : done) {
+        auto it = conns_.find(d.conn);
+        if (it == conns_.end()) continue; // клиент уже отключился
+        it->second.ready.emplace(d.seq, std::move(d.response));
+        flush(d.conn);
+    }
+}
+
+void QueryServer::flush(uint64_t id) {
+    auto it = conns_.find(id);
+    if (it == conns_.end()) return;
+    Connection& c = it->second;
+
+    // переносим в выходной буфер ответы, идущие подряд от send_seq
+    for (auto r = c.ready.begin(); r != c.ready.end() && r->first == c.send_seq; r = c.ready.erase(r)) {
+        c.out += r->second;
+        c.out += '\n';
+        ++c.send_seq;
+    }
+
+    size_t sent = 0;
+    while (sent < c.out.size()) {
+        const ssize_t n = ::send(c.fd, c.out.data() + sent, c.out.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) { sent += static_cast<size_t>(n); continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        close_connection(id);
+        return;
+    }
+    c.out.erase(0, sent);
+
+    // клиент закрыл запись и всё, что он спросил, отправлено
+    if (c.eof && c.out.empty() && c.send_seq == c.next_seq) {
+        close_connection(id);
+        return;
+    }
+
+    // После EOF чтение больше не слушаем. EPOLLHUP/EPOLLERR приходят при любой
+    // маске, поэтому сокет без ожидающего вывода вовсе убираем из epoll (ответы
+    // воркеров разбудят цикл через wake_fd_) и возвращаем только ради EPOLLOUT.
+    const uint32_t events = (c.eof ? 0u : static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP))
+                          | (c.out.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+    if (events != c.events) {
+        if (events == 0) epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, c.fd, nullptr);
+        else epoll_set(epoll_fd_, c.events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, c.fd, events, id);
+        c.events = events;
+    }
+}
+
+void QueryServer::close_connection(uint64_t id) {
+    auto it = conns_.find(id);
+    if (it == conns_.end()) return;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    ::close(it->second.fd);
+    conns_.erase(it);
+}
+
+#else
+
+QueryServer::QueryServer(const SearchServer& search, size_t threads)
+    : search_(search), pool_(std::make_unique<ThreadPool>(threads)) {}
+
+QueryServer::~QueryServer() = default;
+
+void QueryServer::listen(const std::string&) {
+    throw std::runtime_error("QueryServer is supported on Linux only");
+}
+
+void QueryServer::run() {
+    throw std::runtime_error("QueryServer is supported on Linux only");
+}
+
+void QueryServer::stop() { stopping_.store(true); }
+
+void QueryServer::accept_all() {}
+void QueryServer::read_from(uint64_t) {}
+void QueryServer::flush(uint64_t) {}
+void QueryServer::close_connection(uint64_t) {}
+void QueryServer::drain_completions() {}
+
+#endif
@@ -1,152 +1,765 @@
 #include "SearchServer.h"
-#include <sstream>
-#include <unordered_map>
-#include <unordered_set>
+#include "Metrics.h"
+#include "Tokenizer.h"
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-static constexpr size_t MAX_WORD_LEN    = 100;
-static constexpr size_t MAX_QUERY_WORDS = 10;
-static constexpr size_t MAX_REQUESTS    = 1000;
+static constexpr size_t MAX_WORD_LEN    = Tokenizer::MAX_WORD_LEN;
 
-// только латиница и пробелы, нижний регистр
-static std::string normalize_q(std::string s) {
-    for (char& ch : s) {
-        if (ch >= 'A' && ch <= 'Z') ch = char(ch - 'A' + 'a');
-        else if (!((ch >= 'a' && ch <= 'z') || ch == ' ')) ch = ' ';
+// Разбивка запроса + фильтрация длины слова. Слова копируются подряд в text
+// (суммарно они не длиннее запроса, поэтому буфер не переезжает и words
+// остаются действительными). Учитываются первые max_words слов (0 — все);
+// об усечении сообщает только основной проход (report).
+static void tokenize_query(const std::string& raw, size_t max_words, std::string& text,
+                           std::vector<std::string_view>& words, bool report = true) {
+    text.clear();
+    text.reserve(raw.size());
+    words.clear();
+    Tokenizer tok(raw, MAX_WORD_LEN);
+    std::string_view w;
+    size_t total = 0;
+    const size_t limit = max_words ? max_words : SIZE_MAX;
+    while (tok.next(w)) {
+        if (total++ >= limit) continue;
+        const size_t at = text.size();
+        text.append(w);
+        words.emplace_back(text.data() + at, w.size());
+    }
+    // Ограничиваем число слов в запросе
+    if (report && total > limit) {
+        SE_METRIC_ADD(SearchQueriesTruncated, 1);
+        std::cerr << "[Query] Truncated to " << limit
+                  << " tokens (had " << total << ")\n";
     }
-    return s;
 }
 
-// Разбивка запроса + фильтрация длины слова
-static std::vector<std::string> tokenize_query(const std::string& raw) {
-    std::vector<std::string> words;
-    std::istringstream iss(normalize_q(raw));
-    std::string w;
-    while (iss >> w) {
-        if (w.size() <= MAX_WORD_LEN) words.push_back(w);
-    }
-    // Ограничиваем число слов в запросе
-    if (words.size() > MAX_QUERY_WORDS) {
-        std::cerr << "[Query] Truncated to " << MAX_QUERY_WORDS
-                  << " tokens (had " << words.size() << ")\n";
-        words.resize(MAX_QUERY_WORDS);
+// уникальные слова запроса в порядке первого появления и номер уникального
+// слова на каждом месте (по умолчанию слов не больше MAX_QUERY_WORDS — хватает
+// линейного поиска)
+static void unique_words(const std::vector<std::string_view>& raw, std::vector<std::string_view>& words,
+                         std::vector<size_t>& sequence) {
+    words.clear();
+    sequence.clear();
+    for (std::string_view w : raw) {
+        const size_t i = static_cast<size_t>(std::find(words.begin(), words.end(), w) - words.begin());
+        if (i == words.size()) words.push_back(w);
+        sequence.push_back(i);
     }
-    return words;
+}
+
+QueryStats& QueryStats::operator+=(const QueryStats& other) {
+    doc_count += other.doc_count;
+    total_length += other.total_length;
+    if (df.size() < other.df.size()) df.resize(other.df.size());
+    for (size_t i = 0; i < other.df.size(); ++i) df[i] += other.df[i];
+    return *this;
+}
+
+void SearchServer::setThreadCount(size_t threads) {
+    if (threads == 1) pool_.reset();
+    else pool_ = std::make_unique<ThreadPool>(threads);
 }
 
 std::vector<std::vector<RelativeIndex>>
 SearchServer::search(const std::vector<std::string>& queries_input) {
-    std::vector<std::vector<RelativeIndex>> all;
-
     // ограничение на количество запросов
     size_t limit_requests = queries_input.size();
-    if (limit_requests > MAX_REQUESTS) {
-        std::cerr << "[Search] Requests truncated to " << MAX_REQUESTS
+    if (max_requests_ && limit_requests > max_requests_) {
+        std::cerr << "[Search] Requests truncated to " << max_requests_
                   << " (had " << limit_requests << ")\n";
-        limit_requests = MAX_REQUESTS;
-    }
-    all.reserve(limit_requests);
-
-    for (size_t qi = 0; qi < limit_requests; ++qi) {
-        // 1) токенизация + ограничения
-        auto words_raw = tokenize_query(queries_input[qi]);
-        if (words_raw.empty()) { all.push_back({}); continue; }
-
-        // 2) уникалльность слов
-        std::vector<std::string> words;
-        words.reserve(words_raw.size());
-        {
-            std::unordered_set<std::string> seen;
-            for (auto& w : words_raw) {
-                if (seen.insert(w).second) words.push_back(std::move(w));
-            }
+        limit_requests = max_requests_;
+    }
+    std::vector<std::vector<RelativeIndex>> all(limit_requests);
+
+    if (!pool_ || limit_requests < 2) {
+        for (size_t qi = 0; qi < limit_requests; ++qi) all[qi] = search_one(queries_input[qi]);
+        return all;
+    }
+
+    // каждый запрос пишет только в свою ячейку — порядок ответов детерминирован
+    const size_t chunks = std::min(limit_requests, pool_->size() * 4);
+    pool_->parallel_for(chunks, [&](size_t c) {
+        const size_t begin = limit_requests * c / chunks;
+        const size_t end   = limit_requests * (c + 1) / chunks;
+        for (size_t qi = begin; qi < end; ++qi) all[qi] = search_one(queries_input[qi]);
+    });
+    return all;
+}
+
+// порядок выдачи: rank ↓, при равенстве doc_id ↑
+static bool better(const RelativeIndex& a, const RelativeIndex& b) {
+    if (a.rank == b.rank) return a.doc_id < b.doc_id;
+    return a.rank > b.rank;
+}
+
+// накопленное за запрос по всем сегментам (для метрик)
+struct QueryTrace {
+    uint64_t intersect_ns = 0;
+    uint64_t postings = 0;
+    uint64_t bytes = 0;
+};
+
+// добавить кандидата в heap лучших limit (на вершине худший)
+static void offer(std::vector<RelativeIndex>& heap, size_t limit, const RelativeIndex& cand) {
+    if (heap.size() < limit) {
+        heap.push_back(cand);
+        std::push_heap(heap.begin(), heap.end(), better);
+    } else if (better(cand, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), better);
+        heap.back() = cand;
+        std::push_heap(heap.begin(), heap.end(), better);
+    }
+}
+
+// Вклад слова для целого блока: простой цикл без ветвлений по массивам,
+// который компилятор векторизует.
+template <class Scorer>
+static void score_block(const Scorer& sc, const typename Scorer::Term& t, const uint32_t* counts,
+                        const uint32_t* lengths, uint32_t n, float* out) {
+    for (uint32_t i = 0; i < n; ++i) out[i] = sc.score(t, counts[i], lengths[i]);
+}
+
+// Запрос из одного слова: пересекать нечего, лист обходится поблочно —
+// длины документов блока собираются в массив, вклады считаются score_block,
+// блоки, чья оценка сверху не выше порога, пропускаются без декодирования.
+template <class Scorer>
+static void search_single(const SegmentView& view, PostingCursor& c, const Scorer& sc,
+                          const typename Scorer::Term& term, size_t limit,
+                          std::vector<RelativeIndex>& heap) {
+    static const uint32_t zero_lengths[PostingCursor::BLOCK] = {};
+    uint32_t lengths[PostingCursor::BLOCK];
+    float scores[PostingCursor::BLOCK];
+    const Segment& seg = *view.segment;
+
+    do {
+        if (heap.size() == limit) {
+            const float threshold = heap.front().rank;
+            if (sc.bound(term, c.max_count()) < threshold) break;
+            uint32_t b = c.block();
+            while (b < c.block_count() && sc.bound(term, c.block_max(b)) < threshold) ++b;
+            if (!c.skip_to_block(b)) break;
         }
 
-        // 3) получаем posting-листы и считаем "редкость"
-        struct WP { std::string word; std::vector<Entry> postings; size_t rare = 0; };
-        std::vector<WP> wps;
-        wps.reserve(words.size());
-        for (const auto& w : words) {
-            auto postings = index_.GetWordCount(w);
-            if (!postings.empty()) {
-                size_t rare = postings.size(); // чем меньше, тем реже слово
-                wps.push_back(WP{ w, std::move(postings), rare });
-            }
+        const uint32_t n = c.block_len();
+        const uint32_t* docs = c.block_docs();
+        const uint32_t* lens = zero_lengths;
+        if (Scorer::needs_length) {
+            for (uint32_t i = 0; i < n; ++i) lengths[i] = seg.length(docs[i]);
+            lens = lengths;
+        }
+        score_block(sc, term, c.block_counts(), lens, n, scores);
+
+        for (uint32_t i = 0; i < n; ++i) {
+            if (heap.size() == limit && scores[i] < heap.front().rank) continue;
+            if (view.is_deleted(docs[i])) continue;
+            offer(heap, limit, RelativeIndex{ docs[i], scores[i] });
         }
-        // если хоть одно из оригинальных слов отсутствует — AND-пересечение даст пусто
-        if (wps.size() != words.size()) { all.push_back({}); continue; }
-
-        // 4) сортируем слова по редкости (самые редкие первыми)
-        std::sort(wps.begin(), wps.end(),
-                  [](const WP& a, const WP& b){ return a.rare < b.rare; });
-
-        // 5) явное пересечение doc-списков (AND)
-        // инициализируем множеством doc_id из самого редкого слова
-        std::vector<size_t> alive;
-        alive.reserve(wps.front().postings.size());
-        for (const auto& e : wps.front().postings) alive.push_back(e.doc_id);
-
-        // пересекаем с остальными словами
-        for (size_t i = 1; i < wps.size() && !alive.empty(); ++i) {
-            std::vector<size_t> next;
-            next.reserve(std::min(alive.size(), wps[i].postings.size()));
-            // два указателя по отсортированным по doc_id векторам
-            size_t p = 0, q = 0;
-            while (p < alive.size() && q < wps[i].postings.size()) {
-                if (alive[p] == wps[i].postings[q].doc_id) {
-                    next.push_back(alive[p]); ++p; ++q;
-                } else if (alive[p] < wps[i].postings[q].doc_id) {
-                    ++p;
-                } else {
-                    ++q;
+    } while (c.next_block());
+}
+
+// что искать: слова запроса в словарях сегментов и режим сопоставления.
+// Внешние векторы только растут (см. QueryScratch): действительны первые
+// segments элементов ids и первые words элементов offsets.
+struct QueryPlan {
+    SearchServer::Match match = SearchServer::Match::All;
+    size_t min_should_match = 1;
+    size_t words = 0;                            // уникальных слов
+    size_t segments = 0;                         // сегментов снимка
+    float dense_fraction = 0.1f;                 // OR: порог плотного накопителя (доля диапазона doc_id)
+    std::vector<std::vector<size_t>> ids;        // ids[s][i] — номер слова i в словаре сегмента s (npos — нет)
+    std::vector<std::vector<uint32_t>> offsets;  // фраза: где во фразе стоит слово i (по возрастанию)
+};
+
+// Рабочая память запроса, своя у каждого потока. Буферы очищаются, но не
+// отпускаются, поэтому в установившемся режиме запрос не обращается к куче.
+struct QueryScratch {
+    std::string text;                      // слова запроса подряд
+    std::vector<std::string_view> raw;     // слова запроса по порядку (в text)
+    std::vector<std::string_view> words;   // уникальные слова
+    std::vector<size_t> sequence;          // номер уникального слова на каждом месте запроса
+    std::vector<std::string_view> sorted;  // слова для ключа кэша
+    std::string key;
+    QueryPlan plan;
+
+    static QueryScratch& local() {
+        static thread_local QueryScratch scratch;
+        return scratch;
+    }
+};
+
+// Рабочая память обхода сегментов под конкретный скорер (веса слов — его тип)
+template <class Scorer>
+struct SegmentScratch {
+    using Term = typename Scorer::Term;
+    std::vector<Term> query_terms;   // вес слова i запроса
+    std::vector<Term> terms;         // веса в порядке курсоров
+    std::vector<size_t> order;
+    std::vector<PostingCursor> cursors;
+    std::vector<PositionReader> readers;
+    std::vector<const std::vector<uint32_t>*> phrase;
+    std::vector<std::vector<uint32_t>> pos;
+    std::vector<float> bound;
+    std::vector<float> prefix;
+    std::vector<uint32_t> queue;
+    std::vector<uint32_t> matched;
+    std::vector<float> acc;          // плотный накопитель: счёт документа min_doc + i
+    std::vector<uint8_t> hits;       // и сколько слов запроса в нём нашлось
+
+    static SegmentScratch& local() {
+        static thread_local SegmentScratch scratch;
+        return scratch;
+    }
+};
+
+// Есть ли в текущем документе курсоров фраза: слово k стоит на позициях
+// start + offsets[k][...] при некотором start. pos — буферы позиций.
+static bool phrase_match(const std::vector<PostingCursor>& cursors, std::vector<PositionReader>& readers,
+                         const std::vector<const std::vector<uint32_t>*>& offsets,
+                         std::vector<std::vector<uint32_t>>& pos) {
+    for (size_t k = 0; k < cursors.size(); ++k) readers[k].read(cursors[k], pos[k]);
+    // кандидаты на начало фразы — по самому редкому слову (оно первое)
+    const uint32_t first = offsets[0]->front();
+    for (uint32_t p : pos[0]) {
+        if (p < first) continue;
+        const uint32_t start = p - first;
+        bool ok = true;
+        for (size_t k = 0; k < cursors.size() && ok; ++k) {
+            for (uint32_t o : *offsets[k])
+                if (!std::binary_search(pos[k].begin(), pos[k].end(), start + o)) { ok = false; break; }
+        }
+        if (ok) return true;
+    }
+    return false;
+}
+
+// Шаги 3-6 в одном сегменте снимка: пересечение (AND), абсолютная релевантность
+// и отбор в общий heap лучших limit по (abs ↓, doc_id ↑), на вершине худший.
+// ids[i] — номер слова i в словаре сегмента, terms[i] — его вес в запросе.
+// offsets (для фразы) — где во фразе стоит каждое слово; совпадения без фразы отбрасываются.
+template <class Scorer>
+static void search_segment(const SegmentView& view, const std::vector<size_t>& ids,
+                           const Scorer& sc, const std::vector<typename Scorer::Term>& query_terms,
+                           const std::vector<std::vector<uint32_t>>* offsets,
+                           size_t limit, std::vector<RelativeIndex>& heap, QueryTrace& trace) {
+    const CompactIndex& ci = view.segment->index;
+    for (size_t t : ids) if (t == CompactIndex::npos) return; // AND в этом сегменте даст пусто
+    if (offsets && !ci.has_positions())
+        throw std::runtime_error("phrase query needs an index with positions");
+    auto& scratch = SegmentScratch<Scorer>::local();
+
+    // 3-4) курсоры по posting-листам (без копирования), самые редкие первыми;
+    // порядок выбирается до создания курсоров, чтобы не двигать их буферы
+    auto& order = scratch.order;
+    order.resize(ids.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(),
+              [&](size_t a, size_t b){ return ci.doc_freq(ids[a]) < ci.doc_freq(ids[b]); });
+    auto& cursors = scratch.cursors;
+    auto& terms = scratch.terms;
+    cursors.clear();
+    terms.clear();
+    for (size_t i : order) {
+        cursors.push_back(ci.cursor(ids[i]));
+        terms.push_back(query_terms[i]);
+    }
+    // позиции читаются только для фразы и только у документов со всеми словами
+    auto& readers = scratch.readers;
+    auto& phrase = scratch.phrase;
+    auto& pos = scratch.pos;
+    if (offsets) {
+        readers.clear();
+        phrase.clear();
+        for (size_t i : order) {
+            readers.push_back(ci.positions(ids[i]));
+            phrase.push_back(&(*offsets)[i]);
+        }
+        if (pos.size() < order.size()) pos.resize(order.size());
+    }
+
+    const uint64_t intersect_start = SE_METRIC_NOW();
+    if (cursors.size() == 1 && !offsets) {
+        search_single(view, cursors.front(), sc, terms.front(), limit, heap);
+    } else {
+        // 5-6) ведёт самый редкий лист, остальные догоняют его через advance_to
+        // max-score: выше суммы оценок листов документ не наберёт
+        float max_possible = 0;
+        for (size_t i = 0; i < cursors.size(); ++i) max_possible += sc.bound(terms[i], cursors[i].max_count());
+
+        PostingCursor& lead = cursors.front();
+        while (!lead.at_end()) {
+            const size_t doc = lead.doc();
+
+            // Когда heap заполнен, документ проходит только со счётом строго выше
+            // худшего: в пределах сегмента уже отобранные doc_id меньше, и при
+            // равенстве они выигрывают; документы других сегментов рассудит better.
+            if (heap.size() == limit) {
+                const float threshold = heap.front().rank;
+                if (max_possible < threshold) break;
+
+                // block-max: оценка сверху для всех doc_id до ближайшей границы блоков
+                float bound = 0;
+                size_t boundary = SIZE_MAX;
+                bool exhausted = false;
+                for (size_t i = 0; i < cursors.size(); ++i) {
+                    const uint32_t b = cursors[i].find_block(doc);
+                    if (b == cursors[i].block_count()) { exhausted = true; break; }
+                    bound += sc.bound(terms[i], cursors[i].block_max(b));
+                    boundary = std::min(boundary, cursors[i].block_last_doc(b));
                 }
+                if (exhausted) break;
+                if (bound < threshold) {
+                    if (boundary == SIZE_MAX || !lead.advance_to(boundary + 1)) break;
+                    continue;
+                }
+            }
+
+            size_t next_doc = doc;
+            bool exhausted = false;
+            for (size_t i = 1; i < cursors.size(); ++i) {
+                if (!cursors[i].advance_to(doc)) { exhausted = true; break; }
+                if (cursors[i].doc() != doc) { next_doc = cursors[i].doc(); break; }
+            }
+            if (exhausted) break;
+            if (next_doc != doc) { lead.advance_to(next_doc); continue; }
+            if (view.is_deleted(doc)) { lead.next(); continue; }
+            if (offsets && !phrase_match(cursors, readers, phrase, pos)) { lead.next(); continue; }
+
+            const uint32_t len = Scorer::needs_length ? view.segment->length(doc) : 0;
+            float sum = 0;
+            for (size_t i = 0; i < cursors.size(); ++i)
+                sum += sc.score(terms[i], static_cast<uint32_t>(cursors[i].count()), len);
+            offer(heap, limit, RelativeIndex{ doc, sum });
+            lead.next();
+        }
+    }
+
+    // при выключенных метриках время — нули, и всё это сворачивается в пустоту
+    trace.intersect_ns += SE_METRIC_NOW() - intersect_start;
+    for (const auto& c : cursors) {
+        trace.postings += c.size();
+        trace.bytes += c.bytes_read();
+    }
+}
+
+// порция счетов плотного накопителя, проверяемая одним сравнением
+static constexpr size_t DENSE_CHUNK = 16;
+
+// есть ли среди a[0, DENSE_CHUNK) значение не меньше t
+static bool any_at_least(const float* a, float t) {
+#if defined(__SSE2__)
+    const __m128 v = _mm_set1_ps(t);
+    __m128 m = _mm_cmpge_ps(_mm_loadu_ps(a), v);
+    m = _mm_or_ps(m, _mm_cmpge_ps(_mm_loadu_ps(a + 4), v));
+    m = _mm_or_ps(m, _mm_cmpge_ps(_mm_loadu_ps(a + 8), v));
+    m = _mm_or_ps(m, _mm_cmpge_ps(_mm_loadu_ps(a + 12), v));
+    return _mm_movemask_ps(m) != 0;
+#else
+    bool any = false;
+    for (size_t i = 0; i < DENSE_CHUNK; ++i) any |= a[i] >= t;
+    return any;
+#endif
+}
+
+// OR для широких запросов (листы покрывают заметную долю сегмента): листы
+// обходятся по одному целиком (term-at-a-time), вклады блока считает
+// score_block и раскладывает в плотный массив счетов по doc_id - min_doc —
+// ни кучи курсоров, ни хеша на posting. Затем один проход по массиву отбирает
+// лучших: порция счетов, где никто не дотягивает до порога heap, отбрасывается
+// одним векторным сравнением. Вклады положительны, поэтому нулевой счёт — «не найден».
+template <class Scorer>
+static void search_segment_dense(const SegmentView& view, const std::vector<size_t>& ids,
+                                 const Scorer& sc, const std::vector<typename Scorer::Term>& query_terms,
+                                 size_t min_should_match, size_t limit,
+                                 std::vector<RelativeIndex>& heap, QueryTrace& trace) {
+    static const uint32_t zero_lengths[PostingCursor::BLOCK] = {};
+    uint32_t lengths[PostingCursor::BLOCK];
+    float scores[PostingCursor::BLOCK];
+    const Segment& seg = *view.segment;
+    const CompactIndex& ci = seg.index;
+    const size_t base = seg.min_doc();
+    const size_t span = seg.docs.back() - base + 1;
+    const size_t padded = (span + DENSE_CHUNK - 1) / DENSE_CHUNK * DENSE_CHUNK;
+    auto& scratch = SegmentScratch<Scorer>::local();
+    auto& acc = scratch.acc;
+    auto& hits = scratch.hits;
+    acc.assign(padded, 0.0f);
+    hits.assign(padded, 0);
+
+    SE_METRIC_ADD(SearchDenseSegments, 1);
+    const uint64_t intersect_start = SE_METRIC_NOW();
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (ids[i] == CompactIndex::npos) continue;
+        PostingCursor c = ci.cursor(ids[i]);
+        if (c.at_end()) continue;
+        do {
+            const uint32_t n = c.block_len();
+            const uint32_t* docs = c.block_docs();
+            const uint32_t* lens = zero_lengths;
+            if (Scorer::needs_length) {
+                for (uint32_t k = 0; k < n; ++k) lengths[k] = seg.length(docs[k]);
+                lens = lengths;
             }
-            alive.swap(next);
-        }
-
-        if (alive.empty()) { all.push_back({}); continue; }
-
-        // 6) считаем абсолютную релевантность ТОЛЬКО по пересечению alive
-        std::unordered_map<size_t, float> abs;
-        abs.reserve(alive.size());
-        for (const auto& wp : wps) {
-            // postings отсортированы по doc_id; аккуратно суммируем только пересекающиеся id
-            size_t q = 0;
-            for (size_t p = 0; p < alive.size() && q < wp.postings.size();) {
-                const size_t aid = alive[p];
-                const size_t pid = wp.postings[q].doc_id;
-                if (aid == pid) {
-                    abs[aid] += static_cast<float>(wp.postings[q].count);
-                    ++p; ++q;
-                } else if (aid < pid) {
-                    ++p;
-                } else {
-                    ++q;
+            score_block(sc, query_terms[i], c.block_counts(), lens, n, scores);
+            for (uint32_t k = 0; k < n; ++k) {
+                const size_t d = docs[k] - base;
+                acc[d] += scores[k];
+                ++hits[d];
+            }
+        } while (c.next_block());
+        trace.postings += c.size();
+        trace.bytes += c.bytes_read();
+    }
+
+    // отбор: пока heap не полон, годится любой найденный документ
+    const float found = std::numeric_limits<float>::min();
+    for (size_t chunk = 0; chunk < padded; chunk += DENSE_CHUNK) {
+        const float threshold = heap.size() == limit ? heap.front().rank : found;
+        if (!any_at_least(acc.data() + chunk, threshold)) continue;
+        for (size_t d = chunk; d < chunk + DENSE_CHUNK; ++d) {
+            if (acc[d] < threshold || hits[d] < min_should_match) continue;
+            if (view.is_deleted(base + d)) continue;
+            offer(heap, limit, RelativeIndex{ base + d, acc[d] });
+        }
+    }
+    trace.intersect_ns += SE_METRIC_NOW() - intersect_start;
+}
+
+// OR с порогом min_should_match в одном сегменте: документ за документом по
+// куче курсоров, упорядоченной по текущему doc_id; объединение листов не строится.
+// MaxScore: листы упорядочены по оценке сверху, и те, чья суммарная оценка ниже
+// порога heap (несущественные), сами кандидатов не порождают — их только
+// догоняют advance_to для документов из существенных листов.
+template <class Scorer>
+static void search_segment_any(const SegmentView& view, const std::vector<size_t>& ids,
+                               const Scorer& sc, const std::vector<typename Scorer::Term>& query_terms,
+                               size_t min_should_match, float dense_fraction, size_t limit,
+                               std::vector<RelativeIndex>& heap, QueryTrace& trace) {
+    const CompactIndex& ci = view.segment->index;
+    auto& scratch = SegmentScratch<Scorer>::local();
+    auto& order = scratch.order;
+    order.clear();
+    size_t postings = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (ids[i] == CompactIndex::npos) continue;
+        order.push_back(i);
+        postings += ci.doc_freq(ids[i]);
+    }
+    if (order.size() < min_should_match) return;
+
+    // листы покрывают заметную долю сегмента — плотный накопитель дешевле
+    // (счётчик слов в документе — байт, отсюда ограничение на их число).
+    // Накопитель занимает весь диапазон doc_id сегмента, а не только его
+    // документы: после слияния с удалениями сегмент бывает редким.
+    const Segment& seg = *view.segment;
+    const size_t span = seg.docs.back() - seg.min_doc() + 1;
+    if (order.size() <= UINT8_MAX
+        && double(postings) >= double(dense_fraction) * double(span)) {
+        search_segment_dense(view, ids, sc, query_terms, min_should_match, limit, heap, trace);
+        return;
+    }
+
+    // по возрастанию оценки сверху
+    auto& bound = scratch.bound;
+    bound.assign(ids.size(), 0);
+    for (size_t i : order) bound[i] = sc.bound(query_terms[i], ci.max_count(ids[i]));
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b){ return bound[a] < bound[b]; });
+    const size_t n = order.size();
+    auto& cursors = scratch.cursors;
+    auto& terms = scratch.terms;
+    auto& prefix = scratch.prefix; // prefix[k] — сумма оценок листов 0..k-1
+    cursors.clear();
+    terms.clear();
+    prefix.assign(n + 1, 0);
+    for (size_t k = 0; k < n; ++k) {
+        cursors.push_back(ci.cursor(ids[order[k]]));
+        terms.push_back(query_terms[order[k]]);
+        prefix[k + 1] = prefix[k] + bound[order[k]];
+    }
+
+    const uint64_t intersect_start = SE_METRIC_NOW();
+    // куча номеров существенных курсоров, на вершине — с наименьшим doc_id
+    const auto later = [&](uint32_t a, uint32_t b){ return cursors[a].doc() > cursors[b].doc(); };
+    auto& queue = scratch.queue;
+    size_t essential = 0; // курсоры [essential, n) — существенные
+    auto rebuild = [&]{
+        queue.clear();
+        for (size_t k = essential; k < n; ++k)
+            if (!cursors[k].at_end()) queue.push_back(static_cast<uint32_t>(k));
+        std::make_heap(queue.begin(), queue.end(), later);
+    };
+    rebuild();
+
+    auto& matched = scratch.matched;
+    while (!queue.empty()) {
+        // порог вырос — часть листов перестаёт быть существенной
+        if (heap.size() == limit && essential < n && prefix[essential + 1] < heap.front().rank) {
+            while (essential < n && prefix[essential + 1] < heap.front().rank) ++essential;
+            rebuild();
+            if (queue.empty()) break;
+        }
+        const float threshold = heap.size() == limit ? heap.front().rank : 0.0f;
+
+        const size_t doc = cursors[queue.front()].doc();
+        matched.clear();
+        while (!queue.empty() && cursors[queue.front()].doc() == doc) {
+            std::pop_heap(queue.begin(), queue.end(), later);
+            matched.push_back(queue.back());
+            queue.pop_back();
+        }
+
+        // несущественные проверяем от самых весомых, пока документ ещё может пройти
+        if (matched.size() + essential >= min_should_match && !view.is_deleted(doc)) {
+            const uint32_t len = Scorer::needs_length ? view.segment->length(doc) : 0;
+            float sum = 0;
+            for (uint32_t k : matched) sum += sc.score(terms[k], static_cast<uint32_t>(cursors[k].count()), len);
+            size_t found = matched.size();
+            bool pass = true;
+            for (size_t k = essential; k-- > 0;) {
+                if (found + k + 1 < min_should_match
+                    || (heap.size() == limit && sum + prefix[k + 1] < threshold)) { pass = false; break; }
+                if (cursors[k].advance_to(doc) && cursors[k].doc() == doc) {
+                    sum += sc.score(terms[k], static_cast<uint32_t>(cursors[k].count()), len);
+                    ++found;
                 }
             }
+            if (pass && found >= min_should_match) offer(heap, limit, RelativeIndex{ doc, sum });
         }
-        if (abs.empty()) { all.push_back({}); continue; }
 
-        // 7) нормализация: rank = abs / max_abs
-        float mx = 0.f;
-        for (const auto& kv : abs) mx = std::max(mx, kv.second);
+        for (uint32_t k : matched) {
+            if (!cursors[k].next()) continue;
+            queue.push_back(k);
+            std::push_heap(queue.begin(), queue.end(), later);
+        }
+    }
 
-        std::vector<RelativeIndex> rel;
-        rel.reserve(abs.size());
-        for (const auto& kv : abs) rel.push_back({ kv.first, kv.second / mx });
+    trace.intersect_ns += SE_METRIC_NOW() - intersect_start;
+    for (const auto& c : cursors) {
+        trace.postings += c.size();
+        trace.bytes += c.bytes_read();
+    }
+}
 
-        // 8) сортировка: rank ↓, при равенстве doc_id ↑
-        std::sort(rel.begin(), rel.end(), [](const RelativeIndex& a, const RelativeIndex& b){
-            if (a.rank == b.rank) return a.doc_id < b.doc_id;
-            return a.rank > b.rank;
-        });
+// Весь запрос для выбранного скорера: веса слов по статистике снимка (или по
+// общей статистике шардов, если она задана) и обход сегментов.
+template <class Scorer>
+static void search_snapshot(const IndexSnapshot& snap, const QueryPlan& plan, const QueryStats* global,
+                            size_t limit, std::vector<RelativeIndex>& heap, QueryTrace& trace) {
+    const Scorer sc;
+    const size_t doc_count = global ? global->doc_count : snap.doc_count;
+    const uint64_t total_length = global ? global->total_length : snap.total_length;
+    CollectionStats stats;
+    stats.doc_count = doc_count;
+    stats.avg_length = doc_count
+        ? static_cast<float>(double(total_length) / double(doc_count)) : 0.0f;
 
-        // 9) Top-N после сортировки
-        if (static_cast<int>(rel.size()) > responses_limit_) rel.resize(responses_limit_);
+    // df — по словарям сегментов; удалённые, но ещё не слитые документы
+    // учитываются, как и в других движках: веса меняются только после слияния
+    // (такое слияние публикует снимок нового поколения, кэш его не переживает)
+    auto& terms = SegmentScratch<Scorer>::local().query_terms;
+    terms.resize(plan.words);
+    for (size_t i = 0; i < plan.words; ++i) {
+        if (global) {
+            terms[i] = sc.term(stats, global->df[i]);
+            continue;
+        }
+        size_t df = 0;
+        for (size_t s = 0; s < snap.segments.size(); ++s) {
+            const size_t t = plan.ids[s][i];
+            if (t != CompactIndex::npos) df += snap.segments[s].segment->index.doc_freq(t);
+        }
+        terms[i] = sc.term(stats, df);
+    }
 
-        all.push_back(std::move(rel));
+    for (size_t s = 0; s < snap.segments.size(); ++s) {
+        const SegmentView& view = snap.segments[s];
+        switch (plan.match) {
+        case SearchServer::Match::All:
+            search_segment(view, plan.ids[s], sc, terms, nullptr, limit, heap, trace);
+            break;
+        case SearchServer::Match::Any:
+            search_segment_any(view, plan.ids[s], sc, terms, plan.min_should_match,
+                               plan.dense_fraction, limit, heap, trace);
+            break;
+        case SearchServer::Match::Phrase:
+            search_segment(view, plan.ids[s], sc, terms, &plan.offsets, limit, heap, trace);
+            break;
+        }
     }
+}
 
-    return all;
+SearchServer::Ranking SearchServer::parseRanking(const std::string& name) {
+    if (name == "count") return Ranking::Count;
+    if (name == "tfidf") return Ranking::TfIdf;
+    if (name == "bm25")  return Ranking::Bm25;
+    throw std::runtime_error("unknown ranking: " + name);
+}
+
+SearchServer::Match SearchServer::parseMatch(const std::string& name) {
+    if (name == "all")    return Match::All;
+    if (name == "any")    return Match::Any;
+    if (name == "phrase") return Match::Phrase;
+    throw std::runtime_error("unknown match mode: " + name);
+}
+
+// запрос целиком в двойных кавычках (пробелы по краям не в счёт)
+static bool quoted(const std::string& query) {
+    const size_t b = query.find_first_not_of(" \t\r\n");
+    const size_t e = query.find_last_not_of(" \t\r\n");
+    return b != std::string::npos && e > b && query[b] == '"' && query[e] == '"';
+}
+
+std::vector<RelativeIndex> SearchServer::searchRaw(const std::string& query, size_t limit,
+                                                   Match match, size_t min_should_match,
+                                                   const QueryStats* stats) const {
+    std::vector<RelativeIndex> out;
+    searchRaw(query, limit, match, min_should_match, out, stats);
+    return out;
+}
+
+QueryStats SearchServer::queryStats(const std::string& query) const {
+    auto& scratch = QueryScratch::local();
+    tokenize_query(query, max_query_words_, scratch.text, scratch.raw, false);
+    unique_words(scratch.raw, scratch.words, scratch.sequence);
+
+    const auto snapshot = index_.Snapshot();
+    QueryStats out;
+    out.doc_count = snapshot->doc_count;
+    out.total_length = snapshot->total_length;
+    out.df.assign(scratch.words.size(), 0);
+    for (const SegmentView& view : snapshot->segments) {
+        const CompactIndex& ci = view.segment->index;
+        for (size_t i = 0; i < scratch.words.size(); ++i) {
+            const size_t t = ci.find(scratch.words[i]);
+            if (t != CompactIndex::npos) out.df[i] += ci.doc_freq(t);
+        }
+    }
+    return out;
+}
+
+void SearchServer::searchRaw(const std::string& query, size_t limit, Match match,
+                             size_t min_should_match, std::vector<RelativeIndex>& heap,
+                             const QueryStats* stats) const {
+    SE_METRIC_TIMER(SearchQueryNs);
+    SE_METRIC_ADD(SearchQueries, 1);
+    heap.clear();
+    auto& scratch = QueryScratch::local();
+
+    // 1) токенизация + ограничения
+    if (quoted(query)) match = Match::Phrase;
+    tokenize_query(query, max_query_words_, scratch.text, scratch.raw);
+    if (scratch.raw.empty()) return;
+
+    // 2) уникальность слов; для фразы запоминаем, на каких местах стоит каждое
+    QueryPlan& plan = scratch.plan;
+    auto& words = scratch.words;
+    auto& sequence = scratch.sequence;
+    unique_words(scratch.raw, words, sequence);
+    if (stats && stats->df.size() != words.size())
+        throw std::runtime_error("query stats do not match the query");
+    // вырожденные случаи сводятся к AND
+    if (match == Match::Any && min_should_match >= words.size()) match = Match::All;
+    if (match == Match::Phrase && sequence.size() == 1) match = Match::All;
+    plan.match = match;
+    plan.min_should_match = std::max<size_t>(1, min_should_match);
+    plan.words = words.size();
+    plan.dense_fraction = dense_fraction_;
+    if (match == Match::Phrase) {
+        if (plan.offsets.size() < words.size()) plan.offsets.resize(words.size());
+        for (size_t i = 0; i < words.size(); ++i) plan.offsets[i].clear();
+        for (size_t i = 0; i < sequence.size(); ++i)
+            plan.offsets[sequence[i]].push_back(static_cast<uint32_t>(i));
+    }
+
+    if (limit == 0) return;
+    const Ranking ranking = ranking_;
+    const auto snapshot = index_.Snapshot();
+
+    // кэш: порядок слов на результат не влияет (кроме фразы), поэтому ключ — отсортированный набор
+    std::string& key = scratch.key;
+    if (cache_.enabled()) {
+        key = std::to_string(static_cast<int>(ranking)) + ' ' + std::to_string(static_cast<int>(match))
+            + ' ' + std::to_string(match == Match::Any ? plan.min_should_match : 0)
+            + ' ' + std::to_string(limit);
+        if (match == Match::Phrase) {
+            for (size_t i : sequence) { key += ' '; key += words[i]; }
+        } else {
+            auto& sorted = scratch.sorted;
+            sorted.assign(words.begin(), words.end());
+            std::sort(sorted.begin(), sorted.end());
+            for (std::string_view w : sorted) { key += ' '; key += w; }
+        }
+        // с чужой статистикой веса другие: она тоже часть ключа, df — в порядке слов ключа
+        if (stats) {
+            key += " | " + std::to_string(stats->doc_count) + ' ' + std::to_string(stats->total_length);
+            for (size_t i = 0; i < words.size(); ++i) {
+                const size_t w = match == Match::Phrase ? i : static_cast<size_t>(
+                    std::find(words.begin(), words.end(), scratch.sorted[i]) - words.begin());
+                key += ' ';
+                key += std::to_string(stats->df[w]);
+            }
+        }
+        if (cache_.get(key, snapshot->generation, heap)) {
+            SE_METRIC_ADD(SearchCacheHits, 1);
+            return;
+        }
+    }
+
+    // 3) слова запроса в словарях сегментов (один раз: нужны и для df, и для курсоров)
+    [[maybe_unused]] const uint64_t lookup_start = SE_METRIC_NOW();
+    plan.segments = snapshot->segments.size();
+    if (plan.ids.size() < plan.segments) plan.ids.resize(plan.segments);
+    for (size_t s = 0; s < plan.segments; ++s) {
+        const CompactIndex& ci = snapshot->segments[s].segment->index;
+        plan.ids[s].clear();
+        for (std::string_view w : words) plan.ids[s].push_back(ci.find(w));
+    }
+    SE_METRIC_OBSERVE(SearchLookupNs, SE_METRIC_NOW() - lookup_start);
+
+    // 4-6) по всем сегментам согласованного снимка в общий heap; скорер
+    // выбирается один раз на запрос, дальше код инстанцирован под него
+    heap.reserve(limit);
+    QueryTrace trace;
+    switch (ranking) {
+    case Ranking::Count:
+        search_snapshot<CountScorer>(*snapshot, plan, stats, limit, heap, trace);
+        break;
+    case Ranking::TfIdf:
+        search_snapshot<TfIdfScorer>(*snapshot, plan, stats, limit, heap, trace);
+        break;
+    case Ranking::Bm25:
+        search_snapshot<Bm25Scorer>(*snapshot, plan, stats, limit, heap, trace);
+        break;
+    }
+    SE_METRIC_OBSERVE(SearchIntersectNs, trace.intersect_ns);
+    SE_METRIC_OBSERVE(SearchPostingsPerQuery, trace.postings);
+    SE_METRIC_OBSERVE(SearchBytesPerQuery, trace.bytes);
+    SE_METRIC_ADD(SearchPostings, trace.postings);
+    SE_METRIC_ADD(SearchBytesRead, trace.bytes);
+
+    // 7) сортировка: rank ↓, при равенстве doc_id ↑
+    [[maybe_unused]] const uint64_t topk_start = SE_METRIC_NOW();
+    std::sort_heap(heap.begin(), heap.end(), better);
+    SE_METRIC_OBSERVE(SearchTopKNs, SE_METRIC_NOW() - topk_start);
+
+    // в кэше — абсолютные значения, нормализация дешёвая и делается на выдаче
+    if (cache_.enabled()) cache_.put(key, snapshot->generation, heap);
+}
+
+void SearchServer::normalize(std::vector<RelativeIndex>& ranked) {
+    if (ranked.empty()) return;
+    // 8-9) rank = abs / max_abs (максимум — первый после сортировки)
+    const float mx = ranked.front().rank;
+    for (auto& r : ranked) r.rank /= mx;
+}
+
+std::vector<RelativeIndex> SearchServer::search_one(const std::string& query) const {
+    auto ranked = searchRaw(query, static_cast<size_t>(responses_limit_));
+    normalize(ranked);
+    return ranked;
 }
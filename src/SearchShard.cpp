@@ -0,0 +1,154 @@
+#include "SearchShard.h"
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+std::vector<QueryStats> LocalShard::queryStats(const std::vector<std::string>& queries) const {
+    std::vector<QueryStats> out(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) out[i] = server_.queryStats(queries[i]);
+    return out;
+}
+
+std::vector<std::vector<RelativeIndex>>
+LocalShard::searchRaw(const std::vector<std::string>& queries, size_t limit,
+                      const std::vector<QueryStats>* stats) const {
+    std::vector<std::vector<RelativeIndex>> out(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        out[i] = server_.searchRaw(queries[i], limit, server_.match(), server_.minShouldMatch(),
+                                   stats ? &(*stats)[i] : nullptr);
+        for (auto& r : out[i]) r.doc_id += doc_offset_;
+    }
+    return out;
+}
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// соединение, закрываемое при выходе из области видимости
+struct Socket {
+    int fd = -1;
+    ~Socket() { if (fd >= 0) ::close(fd); }
+};
+
+static std::runtime_error shard_error(const std::string& address, const std::string& what) {
+    return std::runtime_error("Shard " + address + ": " + what);
+}
+
+static void connect_to(Socket& s, const std::string& address) {
+    if (address.rfind("unix:", 0) == 0) {
+        const std::string path = address.substr(5);
+        sockaddr_un addr{};
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) throw shard_error(address, "bad path");
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        s.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (s.fd < 0 || connect(s.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+            throw shard_error(address, std::strerror(errno));
+    } else if (address.rfind("tcp:", 0) == 0) {
+        int port = -1;
+        try { port = std::stoi(address.substr(4)); } catch (...) {}
+        if (port < 0 || port > 65535) throw shard_error(address, "bad port");
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        s.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (s.fd < 0 || connect(s.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+            throw shard_error(address, std::strerror(errno));
+    } else {
+        throw shard_error(address, "unknown address (expected unix:PATH or tcp:PORT)");
+    }
+}
+
+// Пакет строк протокола уходит одной пачкой по одному соединению (сервер
+// читает и буферизует ответы сам); ответы разбираются по порядку, on_reply(i, r).
+template <class OnReply>
+static void exchange(const std::string& address, const std::vector<std::string>& lines, OnReply&& on_reply) {
+    if (lines.empty()) return;
+    Socket s;
+    connect_to(s, address);
+
+    std::string batch;
+    for (const auto& line : lines) batch += line + "\n";
+    for (size_t sent = 0; sent < batch.size();) {
+        const ssize_t n = ::send(s.fd, batch.data() + sent, batch.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw shard_error(address, std::strerror(errno));
+        sent += static_cast<size_t>(n);
+    }
+    ::shutdown(s.fd, SHUT_WR);
+
+    std::string in;
+    char buf[16384];
+    size_t next = 0, pos = 0;
+    while (next < lines.size()) {
+        const size_t nl = in.find('\n', pos);
+        if (nl == std::string::npos) {
+            const ssize_t n = ::recv(s.fd, buf, sizeof(buf), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) throw shard_error(address, "connection closed after " + std::to_string(next) + " answers");
+            in.append(buf, static_cast<size_t>(n));
+            continue;
+        }
+        const json r = json::parse(in.begin() + static_cast<std::ptrdiff_t>(pos),
+                                   in.begin() + static_cast<std::ptrdiff_t>(nl));
+        pos = nl + 1;
+        if (r.contains("error")) throw shard_error(address, r["error"].get<std::string>());
+        if (r.value("id", SIZE_MAX) != next) throw shard_error(address, "answers out of order");
+        on_reply(next, r);
+        ++next;
+    }
+}
+
+std::vector<QueryStats> RemoteShard::queryStats(const std::vector<std::string>& queries) const {
+    std::vector<QueryStats> out(queries.size());
+    std::vector<std::string> lines(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i)
+        lines[i] = json{ {"id", i}, {"query", queries[i]}, {"query_stats", true} }.dump();
+    exchange(address_, lines, [&](size_t i, const json& r) {
+        out[i].doc_count = r["doc_count"].get<size_t>();
+        out[i].total_length = r["total_length"].get<uint64_t>();
+        out[i].df = r["df"].get<std::vector<size_t>>();
+    });
+    return out;
+}
+
+std::vector<std::vector<RelativeIndex>>
+RemoteShard::searchRaw(const std::vector<std::string>& queries, size_t limit,
+                       const std::vector<QueryStats>* stats) const {
+    std::vector<std::vector<RelativeIndex>> out(queries.size());
+    std::vector<std::string> lines(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        json req{ {"id", i}, {"query", queries[i]}, {"raw", true}, {"limit", limit} };
+        if (stats) {
+            const QueryStats& st = (*stats)[i];
+            req["global_stats"] = { {"doc_count", st.doc_count}, {"total_length", st.total_length}, {"df", st.df} };
+        }
+        lines[i] = req.dump();
+    }
+    exchange(address_, lines, [&](size_t i, const json& r) {
+        for (const auto& e : r["relevance"])
+            out[i].push_back(RelativeIndex{ e["docid"].get<size_t>(), e["rank"].get<float>() });
+    });
+    return out;
+}
+
+#else
+
+std::vector<QueryStats> RemoteShard::queryStats(const std::vector<std::string>&) const {
+    throw std::runtime_error("RemoteShard is supported on Linux only");
+}
+
+std::vector<std::vector<RelativeIndex>>
+RemoteShard::searchRaw(const std::vector<std::string>&, size_t, const std::vector<QueryStats>*) const {
+    throw std::runtime_error("RemoteShard is supported on Linux only");
+}
+
+#endif
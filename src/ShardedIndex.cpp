@@ -0,0 +1,58 @@
+#include "ShardedIndex.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <stdexcept>
+
+ShardedIndex::ShardedIndex(size_t shards) {
+    if (shards == 0) throw std::runtime_error("ShardedIndex needs at least one shard");
+    shards_.resize(shards);
+}
+
+std::pair<size_t, size_t> ShardedIndex::shard_range(size_t n, size_t shards, size_t s) {
+    return { n * s / shards, n * (s + 1) / shards };
+}
+
+template <class Build>
+void ShardedIndex::build(size_t n, Build&& build_shard) {
+    const size_t count = shards_.size();
+    const size_t total = threads_ ? threads_ : ThreadPool::default_threads();
+    // каждому шарду — свою долю потоков, а шарды строятся одновременно
+    const size_t per_shard = std::max<size_t>(1, total / count);
+    for (size_t s = 0; s < count; ++s) {
+        shards_[s] = std::make_unique<LocalShard>(shard_range(n, count, s).first);
+        shards_[s]->index().setThreadCount(per_shard);
+    }
+    ThreadPool pool(std::min(count, total));
+    pool.parallel_for(count, [&](size_t s) {
+        const auto [begin, end] = shard_range(n, count, s);
+        build_shard(*shards_[s], begin, end);
+    });
+}
+
+void ShardedIndex::UpdateDocumentBase(const std::vector<std::string>& input_docs) {
+    build(input_docs.size(), [&](LocalShard& shard, size_t begin, size_t end) {
+        shard.index().UpdateDocumentBase(std::vector<std::string>(
+            input_docs.begin() + static_cast<std::ptrdiff_t>(begin),
+            input_docs.begin() + static_cast<std::ptrdiff_t>(end)));
+    });
+}
+
+void ShardedIndex::UpdateDocumentBaseFromFiles(const std::vector<std::string>& paths) {
+    build(paths.size(), [&](LocalShard& shard, size_t begin, size_t end) {
+        shard.index().UpdateDocumentBaseFromFiles(std::vector<std::string>(
+            paths.begin() + static_cast<std::ptrdiff_t>(begin),
+            paths.begin() + static_cast<std::ptrdiff_t>(end)));
+    });
+}
+
+size_t ShardedIndex::DocumentCount() const {
+    size_t n = 0;
+    for (const auto& s : shards_) if (s) n += s->index().DocumentCount();
+    return n;
+}
+
+std::vector<const SearchShard*> ShardedIndex::shards() const {
+    std::vector<const SearchShard*> out;
+    for (const auto& s : shards_) if (s) out.push_back(s.get());
+    return out;
+}
@@ -0,0 +1,89 @@
+#include "ShardedSearchServer.h"
+#include <algorithm>
+#include <type_traits>
+#include <iostream>
+
+void ShardedSearchServer::setThreadCount(size_t threads) {
+    if (threads == 1) pool_.reset();
+    else pool_ = std::make_unique<ThreadPool>(threads);
+}
+
+std::vector<std::vector<RelativeIndex>>
+ShardedSearchServer::search(const std::vector<std::string>& queries_input) {
+    size_t limit_requests = queries_input.size();
+    if (max_requests_ && limit_requests > max_requests_) {
+        std::cerr << "[Search] Requests truncated to " << max_requests_
+                  << " (had " << limit_requests << ")\n";
+        limit_requests = max_requests_;
+    }
+    const std::vector<std::string> queries(queries_input.begin(),
+        queries_input.begin() + static_cast<std::ptrdiff_t>(limit_requests));
+    const size_t limit = static_cast<size_t>(responses_limit_);
+    const size_t shards = shards_.size();
+
+    // scatter: задание = (шард, часть пакета); каждое пишет только в свою ячейку
+    std::vector<std::vector<RelativeIndex>> all(queries.size());
+    if (queries.empty() || shards == 0) return all;
+    size_t chunks = 1;
+    if (pool_) chunks = std::max<size_t>(1, std::min(queries.size(), pool_->size() * 4 / shards));
+    auto chunk = [&](const auto& v, size_t c) {
+        using V = std::decay_t<decltype(v)>;
+        return V(v.begin() + static_cast<std::ptrdiff_t>(v.size() * c / chunks),
+                 v.begin() + static_cast<std::ptrdiff_t>(v.size() * (c + 1) / chunks));
+    };
+    auto for_tasks = [&](auto&& run) {
+        if (pool_) pool_->parallel_for(shards * chunks, run);
+        else for (size_t t = 0; t < shards * chunks; ++t) run(t);
+    };
+
+    // первый проход: статистика корпуса для слов каждого запроса, сложенная по
+    // шардам, — с ней TF-IDF и BM25 шардов дают сравнимые абсолютные ранги
+    // (для одного шарда своя статистика и есть общая, Count её не использует)
+    std::vector<QueryStats> stats;
+    if (shards > 1 && std::any_of(shards_.begin(), shards_.end(),
+                                  [](const SearchShard* s) { return s->needsStats(); })) {
+        std::vector<std::vector<std::vector<QueryStats>>> local(
+            shards, std::vector<std::vector<QueryStats>>(chunks));
+        for_tasks([&](size_t task) {
+            const size_t s = task / chunks, c = task % chunks;
+            local[s][c] = shards_[s]->queryStats(chunk(queries, c));
+        });
+        stats.resize(queries.size());
+        for (size_t c = 0; c < chunks; ++c) {
+            const size_t begin = queries.size() * c / chunks;
+            for (size_t s = 0; s < shards; ++s)
+                for (size_t i = 0; i < local[s][c].size(); ++i) stats[begin + i] += local[s][c][i];
+        }
+    }
+
+    std::vector<std::vector<std::vector<std::vector<RelativeIndex>>>> partial(
+        shards, std::vector<std::vector<std::vector<RelativeIndex>>>(chunks));
+    for_tasks([&](size_t task) {
+        const size_t s = task / chunks, c = task % chunks;
+        if (stats.empty()) {
+            partial[s][c] = shards_[s]->searchRaw(chunk(queries, c), limit);
+        } else {
+            const auto part = chunk(stats, c);
+            partial[s][c] = shards_[s]->searchRaw(chunk(queries, c), limit, &part);
+        }
+    });
+
+    // gather: общий top-N по (abs ↓, doc_id ↑) и нормализация по общему максимуму
+    for (size_t c = 0; c < chunks; ++c) {
+        const size_t begin = queries.size() * c / chunks;
+        for (size_t s = 0; s < shards; ++s)
+            for (size_t i = 0; i < partial[s][c].size(); ++i) {
+                auto& dst = all[begin + i];
+                dst.insert(dst.end(), partial[s][c][i].begin(), partial[s][c][i].end());
+            }
+    }
+    for (auto& ranked : all) {
+        std::sort(ranked.begin(), ranked.end(), [](const RelativeIndex& a, const RelativeIndex& b) {
+            if (a.rank == b.rank) return a.doc_id < b.doc_id;
+            return a.rank > b.rank;
+        });
+        if (ranked.size() > limit) ranked.resize(limit);
+        SearchServer::normalize(ranked);
+    }
+    return all;
+}
@@ -0,0 +1,106 @@
+#include "ThreadPool.h"
+#include <exception>
+
+size_t ThreadPool::default_threads() {
+    const unsigned hc = std::thread::hardware_concurrency();
+    return hc ? hc : 1;
+}
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) threads = default_threads();
+    queues_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) queues_.push_back(std::make_unique<Queue>());
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) workers_.emplace_back([this, i]{ worker_loop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(wake_m_);
+        stop_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // раскладываем задачи по очередям по кругу, дальше балансирует stealing
+    const size_t qi = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    {
+        std::lock_guard<std::mutex> lk(queues_[qi]->m);
+        queues_[qi]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lk(wake_m_);
+        queued_.fetch_add(1, std::memory_order_release);
+    }
+    wake_cv_.notify_one();
+}
+
+// свою очередь берём с конца (LIFO, тёплый кэш), чужие — с начала
+bool ThreadPool::try_run_one(size_t home) {
+    const size_t n = queues_.size();
+    for (size_t k = 0; k < n; ++k) {
+        const size_t qi = (home + k) % n;
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lk(queues_[qi]->m);
+            auto& q = queues_[qi]->tasks;
+            if (q.empty()) continue;
+            if (k == 0) { task = std::move(q.back()); q.pop_back(); }
+            else        { task = std::move(q.front()); q.pop_front(); }
+        }
+        queued_.fetch_sub(1, std::memory_order_acq_rel);
+        task();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(size_t id) {
+    for (;;) {
+        if (try_run_one(id)) continue;
+        std::unique_lock<std::mutex> lk(wake_m_);
+        wake_cv_.wait(lk, [this]{ return stop_ || queued_.load(std::memory_order_acquire) > 0; });
+        if (stop_ && queued_.load(std::memory_order_acquire) == 0) return;
+    }
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t)>& fn) {
+    if (n == 0) return;
+
+    struct Latch {
+        std::mutex m;
+        std::condition_variable cv;
+        size_t left;
+        std::exception_ptr error;
+    };
+    auto latch = std::make_shared<Latch>();
+    latch->left = n;
+
+    for (size_t i = 0; i < n; ++i) {
+        submit([latch, &fn, i]{
+            std::exception_ptr err;
+            try { fn(i); }
+            catch (...) { err = std::current_exception(); }
+            std::lock_guard<std::mutex> lk(latch->m);
+            if (err && !latch->error) latch->error = err;
+            if (--latch->left == 0) latch->cv.notify_all();
+        });
+    }
+
+    // помогаем пулу, пока есть работа, затем ждём хвост
+    const size_t home = next_queue_.load(std::memory_order_relaxed) % queues_.size();
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lk(latch->m);
+            if (latch->left == 0) break;
+        }
+        if (!try_run_one(home)) {
+            std::unique_lock<std::mutex> lk(latch->m);
+            latch->cv.wait(lk, [&]{ return latch->left == 0; });
+            break;
+        }
+    }
+    if (latch->error) std::rethrow_exception(latch->error);
+}
@@ -0,0 +1,225 @@
+#include "Tokenizer.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// класс символа за одно обращение к таблице: 0 — разделитель, иначе буква в нижнем регистре
+struct CharTable {
+    uint8_t lower[256];
+    constexpr CharTable() : lower() {
+        for (int c = 'a'; c <= 'z'; ++c) lower[c] = static_cast<uint8_t>(c);
+        for (int c = 'A'; c <= 'Z'; ++c) lower[c] = static_cast<uint8_t>(c - 'A' + 'a');
+    }
+};
+static constexpr CharTable TABLE;
+
+// Двухбайтовые символы U+0080–U+052F: 0 — разделитель, иначе буква в нижнем
+// регистре. Трёх- и четырёхбайтовые символы — всегда разделители.
+struct FoldTable {
+    static constexpr uint32_t END = 0x530;
+    uint16_t lower[END];
+
+    constexpr void same(uint32_t from, uint32_t to) {
+        for (uint32_t c = from; c <= to; ++c) lower[c] = static_cast<uint16_t>(c);
+    }
+    // пары «заглавная, строчная» подряд; заглавная на позиции с чётностью parity
+    constexpr void pairs(uint32_t from, uint32_t to, uint32_t parity) {
+        for (uint32_t c = from; c <= to; ++c)
+            lower[c] = static_cast<uint16_t>((c & 1) == parity ? c + 1 : c);
+    }
+    constexpr FoldTable() : lower() {
+        // Latin-1: À–Þ → à–þ (кроме ×), ß и à–ÿ (кроме ÷) — строчные
+        for (uint32_t c = 0xC0; c <= 0xDE; ++c) lower[c] = static_cast<uint16_t>(c + 0x20);
+        lower[0xD7] = 0;
+        same(0xDF, 0xFF);
+        lower[0xF7] = 0;
+        // Latin Extended-A
+        pairs(0x100, 0x137, 0);
+        same(0x130, 0x131);              // İ и ı — без простого соответствия
+        same(0x138, 0x138);
+        pairs(0x139, 0x148, 1);
+        same(0x149, 0x149);
+        pairs(0x14A, 0x177, 0);
+        lower[0x178] = 0xFF;             // Ÿ → ÿ
+        pairs(0x179, 0x17E, 1);
+        lower[0x17F] = 's';              // ſ → s
+        // Latin Extended-B: буквы; регистр — только для регулярных участков
+        same(0x180, 0x24F);
+        lower[0x1C4] = lower[0x1C5] = 0x1C6;   // DŽ Dž → dž
+        lower[0x1C7] = lower[0x1C8] = 0x1C9;   // LJ Lj → lj
+        lower[0x1CA] = lower[0x1CB] = 0x1CC;   // NJ Nj → nj
+        pairs(0x1CD, 0x1DC, 1);
+        pairs(0x1DE, 0x1EF, 0);
+        lower[0x1F1] = lower[0x1F2] = 0x1F3;   // DZ Dz → dz
+        pairs(0x1F4, 0x1F5, 0);
+        pairs(0x1F8, 0x21F, 0);
+        pairs(0x222, 0x233, 0);
+        pairs(0x246, 0x24F, 0);
+        // комбинируемые диакритические знаки (разложенные й, ё...) — часть слова
+        same(0x300, 0x36F);
+        // кириллица: Ѐ–Џ → ѐ–џ, А–Я → а–я, дальше в основном пары
+        for (uint32_t c = 0x400; c <= 0x40F; ++c) lower[c] = static_cast<uint16_t>(c + 0x50);
+        for (uint32_t c = 0x410; c <= 0x42F; ++c) lower[c] = static_cast<uint16_t>(c + 0x20);
+        same(0x430, 0x45F);
+        pairs(0x460, 0x481, 0);
+        same(0x483, 0x487);              // комбинируемые знаки (титло и др.)
+        pairs(0x48A, 0x4BF, 0);
+        lower[0x4C0] = 0x4CF;            // Ӏ → ӏ
+        pairs(0x4C1, 0x4CE, 1);
+        same(0x4CF, 0x4CF);
+        pairs(0x4D0, 0x52F, 0);
+    }
+};
+static constexpr FoldTable FOLD;
+
+// длина символа UTF-8 в s[pos..n) и его двухбайтовый код (0 — иной символ
+// или некорректная последовательность, тогда длина 1)
+static size_t decode(const uint8_t* s, size_t pos, size_t n, uint32_t& cp) {
+    const uint8_t b = s[pos];
+    cp = 0;
+    auto cont = [&](size_t k) { return pos + k < n && (s[pos + k] & 0xC0) == 0x80; };
+    if (b >= 0xC2 && b <= 0xDF && cont(1)) {
+        cp = (uint32_t(b & 0x1F) << 6) | (s[pos + 1] & 0x3F);
+        return 2;
+    }
+    if (b >= 0xE0 && b <= 0xEF && cont(1) && cont(2)) return 3;
+    if (b >= 0xF0 && b <= 0xF4 && cont(1) && cont(2) && cont(3)) return 4;
+    return 1;
+}
+
+static uint32_t fold(uint32_t cp) {
+    return cp < FoldTable::END ? FOLD.lower[cp] : 0;
+}
+
+// конец участка чистого ASCII, начиная с from (до первого байта ≥ 0x80): целые
+// блоки по 32 байта проверяются разом (старшие биты байтов — movemask), остаток — побайтно
+static size_t ascii_run(const uint8_t* s, size_t from, size_t n) {
+    size_t i = from;
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; i + 32 <= n; i += 32) {
+#if defined(__AVX2__)
+        const uint32_t high = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i))));
+#else
+        const uint32_t high =
+            static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i))))
+          | static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 16)))) << 16;
+#endif
+        if (high) break;   // точное место — побайтно
+    }
+#endif
+    while (i < n && s[i] < 0x80) ++i;
+    return i;
+}
+
+// Быстрый путь: внутри участка чистого ASCII слова разбираются по таблице,
+// как раньше. Всё, что касается не-ASCII байтов, уходит в next_general.
+bool Tokenizer::next(std::string_view& word) {
+    const auto* s = reinterpret_cast<const uint8_t*>(text_.data());
+    const size_t n = text_.size();
+    size_t pos = pos_, end = ascii_end_;   // байты [pos, end) — заведомо ASCII
+    for (;;) {
+        if (pos >= end) {
+            if (pos >= n || s[pos] >= 0x80) break;
+            end = ascii_run(s, pos, n);
+        }
+        while (pos < end && !TABLE.lower[s[pos]]) ++pos;
+        if (pos == end) continue;
+
+        const size_t start = pos;
+        uint8_t upper = 0;  // были ли заглавные
+        while (pos < end && TABLE.lower[s[pos]]) {
+            upper |= TABLE.lower[s[pos]] ^ s[pos];
+            ++pos;
+        }
+        // слово продолжается не-ASCII символом — разбираем его заново общим путём
+        if (pos < n && pos == end) {
+            pos = start;
+            break;
+        }
+        const size_t len = pos - start;
+        if (len > max_word_len_) continue;
+
+        pos_ = pos;
+        ascii_end_ = end;
+        if (!upper) {
+            stable_ = true;
+            word = text_.substr(start, len);
+        } else {
+            stable_ = false;
+            for (size_t i = 0; i < len; ++i) buf_[i] = static_cast<char>(TABLE.lower[s[start + i]]);
+            word = std::string_view(buf_, len);
+        }
+        return true;
+    }
+    pos_ = pos;
+    ascii_end_ = end;
+    return pos < n && next_general(word);
+}
+
+// Общий путь: декодирование UTF-8 с pos_ до конца очередного слова.
+bool Tokenizer::next_general(std::string_view& word) {
+    const auto* s = reinterpret_cast<const uint8_t*>(text_.data());
+    const size_t n = text_.size();
+    uint32_t cp = 0;
+    for (;;) {
+        // разделители
+        while (pos_ < n) {
+            if (s[pos_] < 0x80) {
+                if (TABLE.lower[s[pos_]]) break;
+                ++pos_;
+            } else {
+                const size_t len = decode(s, pos_, n, cp);
+                if (fold(cp)) break;
+                pos_ += len;
+            }
+        }
+        if (pos_ >= n) return false;
+
+        // слово: считаем символы и отмечаем, нужно ли понижать регистр
+        const size_t start = pos_;
+        size_t chars = 0;
+        bool changed = false;
+        for (; pos_ < n; ++chars) {
+            if (s[pos_] < 0x80) {
+                if (!TABLE.lower[s[pos_]]) break;
+                changed |= TABLE.lower[s[pos_]] != s[pos_];
+                ++pos_;
+            } else {
+                const size_t len = decode(s, pos_, n, cp);
+                const uint32_t lower = fold(cp);
+                if (!lower) break;
+                changed |= lower != cp;
+                pos_ += len;
+            }
+        }
+        if (chars > max_word_len_) continue;
+
+        if (!changed) {
+            stable_ = true;
+            word = text_.substr(start, pos_ - start);
+            return true;
+        }
+        // понижение регистра; в нижнем регистре слово не длиннее (в байтах)
+        stable_ = false;
+        size_t out = 0;
+        for (size_t i = start; i < pos_;) {
+            if (s[i] < 0x80) {
+                buf_[out++] = static_cast<char>(TABLE.lower[s[i++]]);
+                continue;
+            }
+            i += decode(s, i, n, cp);
+            const uint32_t lower = fold(cp);
+            if (lower < 0x80) {
+                buf_[out++] = static_cast<char>(lower);
+            } else {
+                buf_[out++] = static_cast<char>(0xC0 | (lower >> 6));
+                buf_[out++] = static_cast<char>(0x80 | (lower & 0x3F));
+            }
+        }
+        word = std::string_view(buf_, out);
+        return true;
+    }
+}
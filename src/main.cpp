@@ -1,34 +1,176 @@
 #include "ConverterJSON.h"
 #include "InvertedIndex.h"
+#include "Metrics.h"
+#include "QueryServer.h"
 #include "SearchServer.h"
+#include "ShardedIndex.h"
+#include "ShardedSearchServer.h"
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 
-int main() {
+static QueryServer* g_server = nullptr;
+
+static void on_signal(int) {
+    if (g_server) g_server->stop();
+}
+
+static std::vector<std::vector<std::pair<int, float>>>
+to_answers(const std::vector<std::vector<RelativeIndex>>& results) {
+    std::vector<std::vector<std::pair<int, float>>> out;
+    for (auto& vec : results) {
+        std::vector<std::pair<int, float>> row;
+        for (auto& r : vec)
+            row.emplace_back(static_cast<int>(r.doc_id), r.rank);
+        out.push_back(std::move(row));
+    }
+    return out;
+}
+
+// app_search_engine                    — пакетный режим: requests.json -> answers.json
+// app_search_engine --serve unix:PATH  — сервер запросов (или --serve tcp:PORT)
+// --shard S/N    — индексировать только S-ю из N частей документов (процесс-шард для --serve)
+// --metrics FILE — по завершении записать метрики (*.prom — Prometheus, иначе JSON)
+int main(int argc, char** argv) {
     try {
+        std::string serve_address, metrics_file;
+        size_t shard = 0, shard_count = 1;
+        for (int i = 1; i < argc; ++i) {
+            unsigned long s = 0, n = 0;
+            if (std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc) serve_address = argv[++i];
+            else if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) metrics_file = argv[++i];
+            else if (std::strcmp(argv[i], "--shard") == 0 && i + 1 < argc
+                     && std::sscanf(argv[++i], "%lu/%lu", &s, &n) == 2 && s < n) {
+                shard = s;
+                shard_count = n;
+            } else {
+                std::cerr << "Usage: " << argv[0]
+                          << " [--serve unix:PATH | --serve tcp:PORT] [--shard S/N] [--metrics FILE]\n";
+                return 2;
+            }
+        }
+        if (shard_count > 1 && serve_address.empty()) {
+            std::cerr << "--shard is used together with --serve\n";
+            return 2;
+        }
+        auto write_metrics = [&]{
+            if (metrics_file.empty()) return;
+            const bool prom = metrics_file.size() > 5
+                && metrics_file.compare(metrics_file.size() - 5, 5, ".prom") == 0;
+            std::ofstream(metrics_file) << (prom ? Metrics::toPrometheus() : Metrics::toJson());
+        };
+
         std::cout << "Starting SkillboxSearchEngine v0.1\n";
 
         ConverterJSON cj;
         cj.setResourcesDir("resources");
 
-        auto docs = cj.GetTextDocuments();
+        const SearchServer::Ranking ranking = SearchServer::parseRanking(cj.GetRanking());
+        const SearchServer::Match match = SearchServer::parseMatch(cj.GetMatch());
+        const size_t min_should_match = cj.GetMinShouldMatch();
+        const bool store_positions = cj.GetStorePositions();
+        const PostingCodec codec = InvertedIndex::parsePostingCodec(cj.GetPostingCodec());
+        const size_t max_doc_words = cj.GetMaxDocWords();
+        const size_t max_query_words = cj.GetMaxQueryWords();
+        // requests.json читается и отвечается пачками — ограничение числа
+        // запросов применяет ProcessRequests, сервер пачку не обрезает
+        auto process_requests = [&](auto& srv) {
+            srv.setMaxRequests(0);
+            cj.ProcessRequests(cj.GetRequestBatch(), cj.GetMaxRequests(),
+                               [&](const std::vector<std::string>& batch) { return to_answers(srv.search(batch)); });
+        };
+
+        // шардированный пакетный режим: процессы-шарды (shard_addresses) или N шардов здесь (shards)
+        const auto shard_addresses = cj.GetShardAddresses();
+        const size_t local_shards = cj.GetShardCount();
+        if (serve_address.empty() && (!shard_addresses.empty() || local_shards > 1)) {
+            std::vector<std::unique_ptr<RemoteShard>> remote;
+            std::unique_ptr<ShardedIndex> sharded;
+            std::vector<const SearchShard*> shards;
+            if (!shard_addresses.empty()) {
+                for (const auto& a : shard_addresses) {
+                    // процессы-шарды читают тот же config.json, ранжирование у них то же
+                    remote.push_back(std::make_unique<RemoteShard>(a, ranking));
+                    shards.push_back(remote.back().get());
+                }
+            } else {
+                sharded = std::make_unique<ShardedIndex>(local_shards);
+                sharded->setThreadCount(cj.GetIndexThreads());
+                for (size_t s = 0; s < sharded->ShardCount(); ++s) {
+                    sharded->shard(s).index().setStorePositions(store_positions);
+                    sharded->shard(s).index().setPostingCodec(codec);
+                    sharded->shard(s).index().setMaxDocWords(max_doc_words);
+                }
+                sharded->UpdateDocumentBaseFromFiles(cj.GetTextDocumentPaths());
+                for (size_t s = 0; s < sharded->ShardCount(); ++s) {
+                    sharded->shard(s).server().setRanking(ranking);
+                    sharded->shard(s).server().setMatch(match, min_should_match);
+                    sharded->shard(s).server().setMaxQueryWords(max_query_words);
+                }
+                shards = sharded->shards();
+            }
+            ShardedSearchServer srv(shards);
+            srv.setResponsesLimit(cj.GetResponsesLimit());
+            srv.setThreadCount(cj.GetSearchThreads());
+            process_requests(srv);
+            write_metrics();
+            std::cout << "Done. See resources/answers.json\n";
+            return 0;
+        }
+
         InvertedIndex idx;
-        idx.UpdateDocumentBase(docs);
+        idx.setThreadCount(cj.GetIndexThreads());
+        idx.setStorePositions(store_positions);
+        idx.setPostingCodec(codec);
+        idx.setMaxDocWords(max_doc_words);
+
+        // сохранённый индекс отображается в память как есть; перестраиваем,
+        // только если файла нет или конфигурация/документы изменились
+        std::string index_file = cj.GetIndexFile();
+        if (shard_count > 1) index_file += "." + std::to_string(shard) + "-of-" + std::to_string(shard_count);
+        const uint64_t fingerprint = cj.GetConfigFingerprint();
+        // процесс-шард индексирует свой непрерывный диапазон документов
+        auto paths = cj.GetTextDocumentPaths();
+        const auto range = ShardedIndex::shard_range(paths.size(), shard_count, shard);
+        if (idx.LoadIndexFile(index_file, fingerprint)) {
+            std::cout << "Index loaded from " << index_file << "\n";
+        } else {
+            paths.assign(paths.begin() + static_cast<std::ptrdiff_t>(range.first),
+                         paths.begin() + static_cast<std::ptrdiff_t>(range.second));
+            // документы читаются потоком через mmap, корпус целиком в памяти не держим
+            idx.UpdateDocumentBaseFromFiles(paths);
+            try { idx.SaveIndexFile(index_file, fingerprint); }
+            catch (const std::exception& e) { std::cerr << e.what() << '\n'; }
+        }
 
         SearchServer srv(idx);
         srv.setResponsesLimit(cj.GetResponsesLimit());
+        srv.setThreadCount(cj.GetSearchThreads());
+        srv.setCacheCapacity(cj.GetCacheBytes());
+        srv.setRanking(ranking);
+        srv.setMatch(match, min_should_match);
+        srv.setMaxQueryWords(max_query_words);
 
-        auto queries = cj.GetRequests();
-        auto results = srv.search(queries);
-
-        std::vector<std::vector<std::pair<int, float>>> out;
-        for (auto& vec : results) {
-            std::vector<std::pair<int, float>> row;
-            for (auto& r : vec)
-                row.emplace_back(static_cast<int>(r.doc_id), r.rank);
-            out.push_back(std::move(row));
+        if (!serve_address.empty()) {
+            // индекс уже в памяти; дальше только запросы, до SIGINT/SIGTERM
+            QueryServer server(srv, cj.GetSearchThreads());
+            server.setDocOffset(range.first);
+            server.listen(serve_address);
+            g_server = &server;
+            std::signal(SIGINT, on_signal);
+            std::signal(SIGTERM, on_signal);
+            std::cout << "Serving on " << serve_address << "\n" << std::flush;
+            server.run();
+            g_server = nullptr;
+            std::cout << "Stopped\n";
+            write_metrics();
+            return 0;
         }
 
-        cj.putAnswers(out);
+        process_requests(srv);
+        write_metrics();
 
         std::cout << "Done. See resources/answers.json\n";
         return 0;
@@ -0,0 +1,112 @@
+#include "gtest/gtest.h"
+#include "InvertedIndex.h"
+#include "SearchServer.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Счётчик выделений памяти во всей программе тестов: глобальный operator new
+// заменён на malloc со счётом. Тесты ниже смотрят только на приращение.
+static atomic<size_t> g_allocations{0};
+
+// Заменяется всё семейство (массивы, nothrow, sized), чтобы new и delete
+// любой формы встречались парами. GCC на -O1 и выше всё равно видит в
+// free() внутри operator delete «несогласованную» пару — это ложное срабатывание.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    g_allocations.fetch_add(1, memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// документ из слов, не влезающих в короткую строку (SSO)
+static string long_words_document(size_t i) {
+    string doc;
+    for (size_t w = 0; w < 50; ++w) {
+        doc += "longindexedword";
+        doc += char('a' + w % 26);
+        doc += char('a' + w / 26);
+        doc += ' ';
+    }
+    doc += (i % 2 ? "odd" : "even");
+    return doc;
+}
+
+static size_t build_allocations(size_t docs) {
+    vector<string> input;
+    for (size_t i = 0; i < docs; ++i) input.push_back(long_words_document(i));
+    InvertedIndex idx;
+    idx.setThreadCount(1);
+    const size_t before = g_allocations.load();
+    idx.UpdateDocumentBase(input);
+    return g_allocations.load() - before;
+}
+
+TEST(TestCaseAllocation, TestIndexBuildIsNotPerPosting) {
+    // словарь не меняется, поэтому лишние документы стоят только роста листов —
+    // а не выделений на каждое слово документа, как было бы без арен
+    const size_t small = build_allocations(1000);
+    const size_t large = build_allocations(2000);
+    EXPECT_LT(large - min(large, small), 1000u);
+}
+
+TEST(TestCaseAllocation, TestSteadyStateQueriesDoNotAllocate) {
+    vector<string> docs;
+    for (size_t i = 0; i < 3000; ++i) {
+        docs.push_back("milk water sugar " + string(i % 3 ? "tea " : "coffee ")
+                       + "word" + char('a' + i % 26) + " extraordinarilylongword");
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    idx.AddDocument("milk water coffee tea");   // несколько сегментов
+    idx.RemoveDocument(7);
+
+    const vector<string> queries = {
+        "milk", "sugar tea coffee", "extraordinarilylongword milk", "wordq water",
+        "\"milk water sugar\"", "missing", "milk water",
+    };
+    const SearchServer::Ranking rankings[] = {
+        SearchServer::Ranking::Count, SearchServer::Ranking::TfIdf, SearchServer::Ranking::Bm25,
+    };
+    const SearchServer::Match matches[] = {
+        SearchServer::Match::All, SearchServer::Match::Any, SearchServer::Match::Phrase,
+    };
+
+    SearchServer srv(idx);
+    vector<RelativeIndex> out;
+    auto run_all = [&]{
+        for (auto ranking : rankings) {
+            srv.setRanking(ranking);
+            for (auto match : matches)
+                for (const auto& q : queries) srv.searchRaw(q, 5, match, 1, out);
+        }
+    };
+    run_all(); // прогрев: буферы потока дорастают до нужного размера
+
+    const size_t before = g_allocations.load();
+    for (int i = 0; i < 20; ++i) run_all();
+    EXPECT_EQ(g_allocations.load() - before, 0u);
+    EXPECT_FALSE(out.empty());
+}
@@ -1,5 +1,9 @@
 #include "gtest/gtest.h"
 #include "InvertedIndex.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
 #include <vector>
 #include <string>
 
@@ -63,3 +67,346 @@ TEST(TestCaseInvertedIndex, TestMissingWord) {
     };
     TestInvertedIndexFunctionality(docs, requests, expected);
 }
+
+TEST(TestCaseInvertedIndex, TestThreadCountIndependent) {
+    vector<string> docs;
+    for (size_t i = 0; i < 300; ++i) {
+        string doc;
+        for (size_t j = 0; j <= i % 17; ++j) doc += "w" + string(1, char('a' + (i * 7 + j) % 26)) + " ";
+        docs.push_back(doc);
+    }
+    InvertedIndex single, multi;
+    single.setThreadCount(1);
+    multi.setThreadCount(4);
+    single.UpdateDocumentBase(docs);
+    multi.UpdateDocumentBase(docs);
+    for (char c = 'a'; c <= 'z'; ++c) {
+        const string w = string("w") + c;
+        ASSERT_EQ(single.GetWordCount(w), multi.GetWordCount(w)) << w;
+    }
+}
+
+TEST(TestCaseInvertedIndex, TestCompactMemory) {
+    vector<string> docs;
+    const vector<string> vocab = {"alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta"};
+    for (size_t i = 0; i < 2000; ++i) {
+        string doc;
+        for (size_t j = 0; j < vocab.size(); ++j)
+            if ((i + j) % 3 != 0) doc += vocab[j] + " ";
+        docs.push_back(doc);
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+
+    size_t postings = 0;
+    for (const auto& w : vocab) postings += idx.GetWordCount(w).size();
+    // прежняя раскладка тратила минимум sizeof(Entry) на каждый posting
+    ASSERT_GT(postings, 0u);
+    ASSERT_LE(idx.MemoryUsage() * 3, postings * sizeof(Entry));
+}
+
+TEST(TestCaseInvertedIndex, TestPostingCursor) {
+    const vector<string> docs = {
+        "milk", "water", "milk water", "tea", "milk", "milk tea"
+    };
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+
+    PostingCursor c = idx.GetPostings("milk");
+    ASSERT_EQ(c.size(), 4u);
+    ASSERT_EQ(c.doc(), 0u);
+    ASSERT_TRUE(c.advance_to(3));
+    ASSERT_EQ(c.doc(), 4u);
+    ASSERT_TRUE(c.advance_to(4));
+    ASSERT_EQ(c.doc(), 4u);
+    ASSERT_TRUE(c.next());
+    ASSERT_EQ(c.doc(), 5u);
+    ASSERT_FALSE(c.next());
+    ASSERT_TRUE(c.at_end());
+
+    ASSERT_TRUE(idx.GetPostings("coffee").at_end());
+}
+
+TEST(TestCaseInvertedIndex, TestPostingCursorBlocks) {
+    vector<string> docs;
+    for (size_t i = 0; i < 1000; ++i) docs.push_back(i % 3 == 0 ? "fizz" : "buzz");
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+
+    const auto fizz = idx.GetWordCount("fizz");
+    ASSERT_EQ(fizz.size(), 334u);
+    for (size_t i = 0; i < fizz.size(); ++i) ASSERT_EQ(fizz[i], (Entry{ i * 3, 1 }));
+
+    PostingCursor c = idx.GetPostings("fizz");
+    ASSERT_TRUE(c.advance_to(500));
+    ASSERT_EQ(c.doc(), 501u);
+    ASSERT_TRUE(c.advance_to(900));
+    ASSERT_EQ(c.doc(), 900u);
+    ASSERT_TRUE(c.next());
+    ASSERT_EQ(c.doc(), 903u);
+    ASSERT_TRUE(c.advance_to(999));
+    ASSERT_EQ(c.doc(), 999u);
+    ASSERT_FALSE(c.advance_to(1000));
+    ASSERT_TRUE(c.at_end());
+}
+
+TEST(TestCaseInvertedIndex, TestPostingCodecs) {
+    // разные интервалы между документами и число вхождений — разная ширина битов в блоках
+    vector<string> docs;
+    for (size_t i = 0; i < 6000; ++i) {
+        string doc = "every";
+        if (i % 3 == 0) for (size_t k = 0; k <= i % 13; ++k) doc += " dense";
+        if (i % 37 == 0 || i % 101 == 0) doc += " sparse";
+        if (i % 2999 == 0) for (size_t k = 0; k < 700; ++k) doc += " heavy";
+        docs.push_back(doc);
+    }
+    const vector<string> words = {"every", "dense", "sparse", "heavy", "missing"};
+    const PostingCodec codecs[] = { PostingCodec::Raw, PostingCodec::Varint, PostingCodec::BitPack };
+
+    InvertedIndex reference;
+    reference.UpdateDocumentBase(docs);
+    size_t bytes[3] = {};
+    for (size_t k = 0; k < 3; ++k) {
+        InvertedIndex idx;
+        idx.setPostingCodec(codecs[k]);
+        idx.UpdateDocumentBase(docs);
+        ASSERT_EQ(idx.Snapshot()->segments.front().segment->index.codec(), codecs[k]);
+        bytes[k] = idx.MemoryUsage();
+        for (const auto& w : words) ASSERT_EQ(idx.GetWordCount(w), reference.GetWordCount(w)) << w << ' ' << k;
+
+        // переходы по таблице пропусков и внутри блоков
+        PostingCursor c = idx.GetPostings("sparse");
+        PostingCursor r = reference.GetPostings("sparse");
+        for (size_t target : {0, 38, 1000, 1001, 4040, 5999}) {
+            ASSERT_EQ(c.advance_to(target), r.advance_to(target));
+            if (!r.at_end()) { ASSERT_EQ(c.doc(), r.doc()); }
+        }
+
+        // добавленные документы и слияние — в той же кодировке
+        idx.AddDocument("dense sparse");
+        idx.MergeSegments();
+        ASSERT_EQ(idx.GetWordCount("sparse").back(), (Entry{ 6000, 1 }));
+        ASSERT_EQ(idx.Snapshot()->segments.front().segment->index.codec(), codecs[k]);
+    }
+    ASSERT_LT(bytes[1], bytes[0]);
+    ASSERT_LT(bytes[2], bytes[0]);
+
+    // кодировка записана в образе: файл читается с ней же, даже если индекс настроен иначе
+    const string path = (filesystem::temp_directory_path() / "se_codec_test.bin").string();
+    {
+        InvertedIndex idx;
+        idx.setPostingCodec(PostingCodec::BitPack);
+        idx.UpdateDocumentBase(docs);
+        idx.SaveIndexFile(path, 7);
+    }
+    InvertedIndex loaded;
+    ASSERT_TRUE(loaded.LoadIndexFile(path, 7));
+    ASSERT_EQ(loaded.Snapshot()->segments.front().segment->index.codec(), PostingCodec::BitPack);
+    for (const auto& w : words) ASSERT_EQ(loaded.GetWordCount(w), reference.GetWordCount(w)) << w;
+    filesystem::remove(path);
+
+    ASSERT_EQ(InvertedIndex::parsePostingCodec("bitpack"), PostingCodec::BitPack);
+    ASSERT_THROW(InvertedIndex::parsePostingCodec("zip"), runtime_error);
+}
+
+TEST(TestCaseInvertedIndex, TestPositions) {
+    // документ i: i % 5 слов-заполнителей, затем "fizz", затем ещё раз "fizz" у каждого третьего
+    vector<string> docs;
+    for (size_t i = 0; i < 1000; ++i) {
+        string doc;
+        for (size_t k = 0; k < i % 5; ++k) doc += "pad ";
+        doc += "fizz";
+        if (i % 3 == 0) doc += " buzz fizz";
+        docs.push_back(doc);
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+
+    const CompactIndex& ci = idx.Snapshot()->segments.front().segment->index;
+    ASSERT_TRUE(ci.has_positions());
+    const size_t t = ci.find("fizz");
+    PostingCursor c = ci.cursor(t);
+    PositionReader r = ci.positions(t);
+    vector<uint32_t> pos;
+    // читаются только нужные posting, пропуская остальные и целые блоки
+    for (size_t target : {0, 7, 300, 301, 999}) {
+        ASSERT_TRUE(c.advance_to(target));
+        r.read(c, pos);
+        const uint32_t first = static_cast<uint32_t>(target % 5);
+        const vector<uint32_t> expected = target % 3 == 0 ? vector<uint32_t>{ first, first + 2 }
+                                                          : vector<uint32_t>{ first };
+        ASSERT_EQ(pos, expected) << target;
+    }
+
+    InvertedIndex plain;
+    plain.setStorePositions(false);
+    plain.UpdateDocumentBase(docs);
+    ASSERT_FALSE(plain.Snapshot()->segments.front().segment->index.has_positions());
+    ASSERT_LT(plain.MemoryUsage(), idx.MemoryUsage());
+}
+
+TEST(TestCaseInvertedIndex, TestIndexFileRoundTrip) {
+    vector<string> docs;
+    for (size_t i = 0; i < 500; ++i) docs.push_back(i % 2 ? "milk water" : "milk milk sugar");
+    InvertedIndex built;
+    built.UpdateDocumentBase(docs);
+
+    const string path = (filesystem::temp_directory_path() / "search_engine_test_index.bin").string();
+    built.SaveIndexFile(path, 42);
+
+    InvertedIndex stale;
+    ASSERT_FALSE(stale.LoadIndexFile(path, 43));
+
+    InvertedIndex loaded;
+    ASSERT_TRUE(loaded.LoadIndexFile(path, 42));
+    ASSERT_EQ(loaded.DocumentCount(), docs.size());
+    for (const string w : {"milk", "water", "sugar", "coffee"})
+        ASSERT_EQ(loaded.GetWordCount(w), built.GetWordCount(w)) << w;
+    ASSERT_EQ(loaded.Snapshot()->total_length, built.Snapshot()->total_length);
+    ASSERT_TRUE(loaded.Snapshot()->segments.front().segment->index.has_positions());
+
+    // испорченный образ не принимается
+    {
+        fstream f(path, ios::in | ios::out | ios::binary);
+        f.seekp(-3, ios::end);
+        f.put('\x7f');
+    }
+    InvertedIndex corrupted;
+    ASSERT_FALSE(corrupted.LoadIndexFile(path, 42));
+    filesystem::remove(path);
+}
+
+TEST(TestCaseInvertedIndex, TestStreamingFromFiles) {
+    vector<string> docs;
+    for (size_t i = 0; i < 300; ++i)
+        docs.push_back(i % 3 ? "Milk water " + to_string(i % 7) : "sugar MILK milk");
+    docs.push_back(""); // пустой файл
+
+    const auto dir = filesystem::temp_directory_path() / "search_engine_stream_test";
+    filesystem::create_directories(dir);
+    vector<string> paths;
+    for (size_t i = 0; i < docs.size(); ++i) {
+        paths.push_back((dir / (to_string(i) + ".txt")).string());
+        ofstream(paths.back(), ios::binary) << docs[i];
+    }
+
+    InvertedIndex expected;
+    expected.UpdateDocumentBase(docs);
+    for (size_t threads : {1, 4}) {
+        InvertedIndex streamed;
+        streamed.setThreadCount(threads);
+        streamed.setKeepDocuments(true);
+        streamed.UpdateDocumentBaseFromFiles(paths);
+        ASSERT_EQ(streamed.DocumentCount(), docs.size());
+        ASSERT_EQ(streamed.Documents(), docs);
+        for (const string w : {"milk", "water", "sugar", "3", "coffee"})
+            ASSERT_EQ(streamed.GetWordCount(w), expected.GetWordCount(w)) << w;
+        // листы и позиции досортированы к тому же порядку — образы совпадают побайтно
+        const CompactIndex& a = streamed.Snapshot()->segments.front().segment->index;
+        const CompactIndex& b = expected.Snapshot()->segments.front().segment->index;
+        ASSERT_TRUE(equal(a.image(), a.image() + a.image_size(), b.image(), b.image() + b.image_size()));
+    }
+    filesystem::remove_all(dir);
+}
+
+TEST(TestCaseInvertedIndex, TestIncrementalUpdates) {
+    InvertedIndex idx;
+    idx.UpdateDocumentBase({ "milk water", "milk", "water" });
+    const auto before = idx.Snapshot();
+
+    ASSERT_EQ(idx.AddDocument("milk milk tea"), 3u);
+    ASSERT_TRUE(idx.RemoveDocument(1));
+    ASSERT_FALSE(idx.RemoveDocument(1));
+    ASSERT_TRUE(idx.ReplaceDocument(0, "tea"));
+    ASSERT_FALSE(idx.ReplaceDocument(42, "tea"));
+
+    const vector<Entry> milk = { {3, 2} };
+    const vector<Entry> tea = { {0, 1}, {3, 1} };
+    const vector<Entry> water = { {2, 1} };
+    ASSERT_EQ(idx.GetWordCount("milk"), milk);
+    ASSERT_EQ(idx.GetWordCount("tea"), tea);
+    ASSERT_EQ(idx.GetWordCount("water"), water);
+    ASSERT_EQ(idx.DocumentCount(), 3u);
+
+    // снимок, взятый до изменений, их не видит
+    ASSERT_EQ(before->doc_count, 3u);
+    ASSERT_EQ(before->segments.size(), 1u);
+
+    idx.MergeSegments();
+    ASSERT_EQ(idx.SegmentCount(), 1u);
+    ASSERT_EQ(idx.GetWordCount("milk"), milk);
+    ASSERT_EQ(idx.GetWordCount("tea"), tea);
+    ASSERT_EQ(idx.GetWordCount("water"), water);
+}
+
+TEST(TestCaseInvertedIndex, TestBackgroundMerge) {
+    InvertedIndex idx;
+    idx.UpdateDocumentBase({ "base" });
+    for (size_t i = 0; i < 100; ++i) {
+        idx.AddDocument("word" + string(1, char('a' + i % 26)) + " common");
+        if (i % 10 == 0) idx.RemoveDocument(i / 2);
+    }
+    idx.WaitForMerges();
+
+    size_t live = 0;
+    for (const auto& e : idx.GetWordCount("common")) { (void)e; ++live; }
+    ASSERT_EQ(idx.DocumentCount(), 1 + 100 - 10);
+    ASSERT_EQ(live + idx.GetWordCount("base").size(), idx.DocumentCount());
+    ASSERT_LE(idx.SegmentCount(), 10u);
+}
+
+// слово номер k из одних букв: wa, wb, ..., wba, ...
+static string letters_word(size_t k) {
+    string w;
+    do { w.insert(w.begin(), char('a' + k % 26)); k /= 26; } while (k);
+    return "w" + w;
+}
+
+TEST(TestCaseInvertedIndex, TestLargeDocument) {
+    // ~3 МБ: без ограничения числа слов разбирается по частям в нескольких потоках
+    string big;
+    size_t words = 0;
+    for (; big.size() < (3u << 20); ++words) {
+        string w = letters_word(words % 5000);
+        if (words % 7 == 0) w[0] = 'W';
+        big += w;
+        big += (words % 11 == 0 ? "\n" : " ");
+    }
+    const vector<string> docs = { "wb wc", big, "wd" };
+
+    InvertedIndex limited;
+    limited.UpdateDocumentBase(docs);
+    ASSERT_EQ(limited.GetWordCount("wb"), (vector<Entry>{ {0, 1}, {1, 1} }));
+
+    InvertedIndex split;
+    split.setThreadCount(4);
+    split.setMaxDocWords(0);
+    split.UpdateDocumentBase(docs);
+    // тот же документ целиком одним потоком
+    InvertedIndex whole;
+    whole.setMaxDocWords(0);
+    for (const auto& d : docs) whole.AddDocument(d);
+
+    ASSERT_EQ(split.Snapshot()->segments.front().segment->length(1), words);
+    auto occurrences = [&](size_t k) { return (words - k + 4999) / 5000; };
+    ASSERT_EQ(split.GetWordCount("wb"), (vector<Entry>{ {0, 1}, {1, occurrences(1)} }));
+    for (size_t k : { 0, 1, 2500, 4999 }) {
+        const string w = letters_word(k);
+        ASSERT_EQ(split.GetWordCount(w), whole.GetWordCount(w)) << w;
+        const auto& a = split.Snapshot()->segments.front().segment->index;
+        vector<uint32_t> pos_split, pos_whole;
+        PostingCursor c = a.cursor(a.find(w));
+        ASSERT_TRUE(c.advance_to(1));
+        a.positions(a.find(w)).read(c, pos_split);
+        for (const auto& seg : whole.Snapshot()->segments) {
+            const auto& b = seg.segment->index;
+            const size_t t = b.find(w);
+            if (t == CompactIndex::npos) continue;
+            PostingCursor cb = b.cursor(t);
+            if (!cb.advance_to(1) || cb.doc() != 1) continue;
+            b.positions(t).read(cb, pos_whole);
+        }
+        ASSERT_EQ(pos_split.size(), occurrences(k)) << w;
+        ASSERT_EQ(pos_split, pos_whole) << w;
+    }
+}
@@ -0,0 +1,155 @@
+#include "gtest/gtest.h"
+#include "ConverterJSON.h"
+#include "JsonWriter.h"
+#include <nlohmann/json.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+TEST(TestCaseJsonWriter, TestMatchesDump) {
+    const json dom = {
+        {"a", json::array()},
+        {"b", json::object()},
+        {"floats", { 0.7f, 1.0, 1e-7, 123456.789, -0.0, 3.0f / 7 }},
+        {"ints", { 0, -5, 1234567890123LL }},
+        {"nested", { {"flag", true}, {"none", nullptr}, {"list", { json::object(), json::array({1}) }} }},
+        {"text", "quote \" slash \\ tab \t newline \n ctrl \x01 юникод"}
+    };
+
+    auto write = [](int indent) {
+        ostringstream os;
+        {
+            JsonWriter w(os, indent);
+            w.beginObject();
+            w.key("a"); w.beginArray(); w.endArray();
+            w.key("b"); w.beginObject(); w.endObject();
+            w.key("floats"); w.beginArray();
+            for (double v : { double(0.7f), 1.0, 1e-7, 123456.789, -0.0, double(3.0f / 7) }) w.value(v);
+            w.endArray();
+            w.key("ints"); w.beginArray();
+            w.value(0); w.value(-5); w.value(int64_t(1234567890123LL));
+            w.endArray();
+            w.key("nested"); w.beginObject();
+            w.key("flag"); w.value(true);
+            w.key("list"); w.beginArray();
+            w.beginObject(); w.endObject();
+            w.beginArray(); w.value(1); w.endArray();
+            w.endArray();
+            w.key("none"); w.null();
+            w.endObject();
+            w.key("text"); w.value("quote \" slash \\ tab \t newline \n ctrl \x01 юникод");
+            w.endObject();
+        }
+        return os.str();
+    };
+    ASSERT_EQ(write(2), dom.dump(2));
+    ASSERT_EQ(write(4), dom.dump(4));
+    ASSERT_EQ(write(-1), dom.dump());
+}
+
+// прежняя реализация putAnswers через DOM — эталон формата
+static string answers_dom(const vector<vector<pair<int, float>>>& answers) {
+    json out; json answers_obj;
+    for (size_t i = 0; i < answers.size(); ++i) {
+        char idbuf[32]; snprintf(idbuf, sizeof(idbuf), "request%03zu", i + 1);
+        if (answers[i].empty()) {
+            answers_obj[idbuf] = { {"result", "false"} };
+        } else {
+            json rel = json::array();
+            for (auto& [doc, rank] : answers[i]) rel.push_back({ {"docid", doc}, {"rank", rank} });
+            answers_obj[idbuf] = { {"result", "true"}, {"relevance", rel} };
+        }
+    }
+    out["answers"] = answers_obj;
+    return out.dump(2);
+}
+
+TEST(TestCaseJsonWriter, TestAnswersMatchDom) {
+    const auto dir = filesystem::temp_directory_path() / "search_engine_answers_test";
+    filesystem::create_directories(dir);
+    ConverterJSON cj;
+    cj.setResourcesDir(dir.string());
+
+    auto read_answers = [&] {
+        ifstream ifs(dir / "answers.json", ios::binary);
+        return string(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+    };
+
+    // 1000 запросов: request1000 при сортировке ключей встаёт за request100
+    vector<vector<pair<int, float>>> answers(1000);
+    for (size_t i = 0; i < answers.size(); ++i)
+        for (size_t k = 0; k < i % 6; ++k)
+            answers[i].push_back({ static_cast<int>(i * 7 + k), 1.0f / float(k + 1) });
+    cj.putAnswers(answers);
+    ASSERT_EQ(read_answers(), answers_dom(answers));
+
+    cj.putAnswers({});
+    ASSERT_EQ(read_answers(), answers_dom({}));
+
+    filesystem::remove_all(dir);
+}
+
+TEST(TestCaseJsonWriter, TestProcessRequestsStreams) {
+    const auto dir = filesystem::temp_directory_path() / "search_engine_stream_test";
+    filesystem::create_directories(dir);
+    ConverterJSON cj;
+    cj.setResourcesDir(dir.string());
+
+    auto read_answers = [&] {
+        ifstream ifs(dir / "answers.json", ios::binary);
+        return string(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+    };
+    auto answer = [](const string& request) {
+        vector<pair<int, float>> row;
+        for (size_t k = 0; k < request.size() % 4; ++k)
+            row.push_back({ static_cast<int>(request.size() + k), 1.0f / float(k + 1) });
+        return row;
+    };
+
+    vector<string> requests;
+    for (size_t i = 0; i < 700; ++i) requests.push_back("request " + string(i % 9, 'x'));
+    ofstream(dir / "requests.json") << json{ {"other", { {"requests", {1, 2}} }}, {"requests", requests} }.dump();
+
+    vector<size_t> batches;
+    auto handler = [&](const vector<string>& batch) {
+        batches.push_back(batch.size());
+        ConverterJSON::Answers out;
+        for (const auto& r : batch) out.push_back(answer(r));
+        return out;
+    };
+    // все запросы пачками по 256 — тот же файл, что и putAnswers разом
+    ASSERT_EQ(cj.ProcessRequests(256, 0, handler), requests.size());
+    ASSERT_EQ(batches, (vector<size_t>{ 256, 256, 188 }));
+    const string streamed = read_answers();
+    ConverterJSON::Answers all;
+    for (const auto& r : requests) all.push_back(answer(r));
+    cj.putAnswers(all);
+    ASSERT_EQ(streamed, read_answers());
+
+    // ограничение числа запросов
+    batches.clear();
+    ASSERT_EQ(cj.ProcessRequests(256, 300, handler), 300u);
+    ASSERT_EQ(batches, (vector<size_t>{ 256, 44 }));
+    all.resize(300);
+    cj.putAnswers(all);
+    const string limited = read_answers();
+    cj.ProcessRequests(256, 300, handler);
+    ASSERT_EQ(read_answers(), limited);
+
+    ofstream(dir / "requests.json") << R"({"requests": []})";
+    cj.ProcessRequests(256, 0, handler);
+    ASSERT_EQ(read_answers(), answers_dom({}));
+
+    ofstream(dir / "requests.json") << R"({"requests": ["ok", 5]})";
+    ASSERT_THROW(cj.ProcessRequests(256, 0, handler), runtime_error);
+
+    filesystem::remove_all(dir);
+}
@@ -0,0 +1,43 @@
+#include "gtest/gtest.h"
+#include "InvertedIndex.h"
+#include "Metrics.h"
+#include "SearchServer.h"
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+TEST(TestCaseMetrics, TestIndexAndSearchRecorded) {
+    Metrics::reset();
+    InvertedIndex idx;
+    idx.setThreadCount(2);
+    idx.UpdateDocumentBase({ "milk water", "milk", "water water" });
+    SearchServer srv(idx);
+    srv.setThreadCount(1);
+    srv.search({ "milk water", "milk", "coffee" });
+
+    const json m = json::parse(Metrics::toJson());
+    if (!Metrics::enabled()) {
+        ASSERT_EQ(m["counters"]["search_queries_total"], 0);
+        return;
+    }
+    ASSERT_EQ(m["counters"]["index_documents_total"], 3);
+    ASSERT_EQ(m["counters"]["search_queries_total"], 3);
+    ASSERT_EQ(m["histograms"]["index_build_ns"]["count"], 1);
+    ASSERT_EQ(m["histograms"]["index_tokenize_ns"]["count"], 3);
+    ASSERT_EQ(m["histograms"]["search_query_ns"]["count"], 3);
+    // "milk water": листы 2 + 2, "milk": 2, "coffee": слова нет
+    ASSERT_EQ(m["counters"]["search_postings_total"], 6);
+    ASSERT_GT(m["counters"]["search_bytes_read_total"], 0);
+    ASSERT_EQ(m["histograms"]["search_topk_ns"]["count"], 3);
+
+    const string prom = Metrics::toPrometheus();
+    ASSERT_NE(prom.find("search_engine_search_queries_total 3\n"), string::npos);
+    ASSERT_NE(prom.find("search_engine_search_query_ns_count 3\n"), string::npos);
+    ASSERT_NE(prom.find("search_engine_search_query_ns_bucket{le=\"+Inf\"} 3\n"), string::npos);
+
+    Metrics::reset();
+    ASSERT_EQ(json::parse(Metrics::toJson())["counters"]["search_queries_total"], 0);
+}
@@ -0,0 +1,130 @@
+#include "gtest/gtest.h"
+#include "InvertedIndex.h"
+#include "QueryServer.h"
+#include "SearchServer.h"
+#include <nlohmann/json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using json = nlohmann::json;
+
+static const vector<string> kDocs = {
+    "milk milk milk milk water water water",
+    "milk water water",
+    "milk milk milk milk milk water water water water water",
+    "americano cappuccino"
+};
+
+TEST(TestCaseQueryServer, TestHandle) {
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(kDocs);
+    SearchServer srv(idx);
+    QueryServer server(srv, 1);
+
+    const json r = json::parse(server.handle(R"({"id": 7, "query": "milk water"})"));
+    ASSERT_EQ(r["id"], 7);
+    ASSERT_EQ(r["relevance"].size(), 3u);
+    ASSERT_EQ(r["relevance"][0]["docid"], 2);
+    ASSERT_FLOAT_EQ(r["relevance"][0]["rank"].get<float>(), 1.0f);
+    ASSERT_TRUE(r.contains("latency_us"));
+
+    ASSERT_EQ(json::parse(server.handle(R"("cappuccino")"))["relevance"][0]["docid"], 3);
+    ASSERT_TRUE(json::parse(server.handle(R"({"id": 1, "query": "sugar"})"))["relevance"].empty());
+
+    const json bad = json::parse(server.handle("{not json"));
+    ASSERT_TRUE(bad.contains("error"));
+    ASSERT_TRUE(json::parse(server.handle(R"({"query": "milk", "limit": 2147483647})")).contains("error"));
+    ASSERT_EQ(json::parse(server.handle(R"({"query": "milk", "limit": 10000})"))["relevance"].size(), 3u);
+
+    const json stats = json::parse(server.handle(R"({"cmd": "stats"})"));
+    ASSERT_EQ(stats["queries"], 6);
+    ASSERT_EQ(stats["errors"], 2);
+}
+
+#ifdef __linux__
+TEST(TestCaseQueryServer, TestUnixSocketPipelined) {
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(kDocs);
+    SearchServer srv(idx);
+    QueryServer server(srv, 4);
+
+    const string path = (filesystem::temp_directory_path() / "search_engine_test.sock").string();
+    server.listen("unix:" + path);
+    thread loop([&]{ server.run(); });
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+    ASSERT_EQ(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+
+    // несколько запросов одной пачкой: ответы должны прийти в том же порядке
+    string batch;
+    const size_t N = 50;
+    for (size_t i = 0; i < N; ++i)
+        batch += json{ {"id", i}, {"query", i % 2 ? "milk" : "americano"} }.dump() + "\n";
+    ASSERT_EQ(send(fd, batch.data(), batch.size(), 0), static_cast<ssize_t>(batch.size()));
+    shutdown(fd, SHUT_WR);
+
+    string received;
+    char buf[4096];
+    for (ssize_t n; (n = recv(fd, buf, sizeof(buf), 0)) > 0;) received.append(buf, static_cast<size_t>(n));
+    close(fd);
+    server.stop();
+    loop.join();
+
+    size_t pos = 0, i = 0;
+    for (size_t nl; (nl = received.find('\n', pos)) != string::npos; pos = nl + 1, ++i) {
+        const json r = json::parse(received.substr(pos, nl - pos));
+        ASSERT_EQ(r["id"], i);
+        ASSERT_EQ(r["relevance"].size(), i % 2 ? 3u : 1u);
+    }
+    ASSERT_EQ(i, N);
+}
+
+TEST(TestCaseQueryServer, TestUnixSocketPathReuse) {
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(kDocs);
+    SearchServer srv(idx);
+    const auto path = filesystem::temp_directory_path() / "search_engine_reuse.sock";
+    filesystem::remove(path);
+
+    // обычный файл по этому пути не удаляется
+    ofstream(path) << "{}";
+    {
+        QueryServer server(srv, 1);
+        ASSERT_THROW(server.listen("unix:" + path.string()), runtime_error);
+    }
+    ASSERT_TRUE(filesystem::is_regular_file(path));
+    filesystem::remove(path);
+
+    // сокет, который никто не слушает (упавший сервер), заменяется
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        ASSERT_GE(fd, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        path.string().copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+        ASSERT_EQ(::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+        close(fd);
+    }
+    QueryServer server(srv, 1);
+    server.listen("unix:" + path.string());
+
+    // сокет живого сервера — занят
+    QueryServer second(srv, 1);
+    ASSERT_THROW(second.listen("unix:" + path.string()), runtime_error);
+    ASSERT_TRUE(filesystem::is_socket(path));
+}
+#endif
@@ -1,6 +1,11 @@
 #include "gtest/gtest.h"
 #include "InvertedIndex.h"
+#include "Metrics.h"
 #include "SearchServer.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <map>
+#include <sstream>
 #include <vector>
 #include <string>
 
@@ -66,3 +71,373 @@ TEST(TestCaseSearchServer, TestTop5) {
 
     ASSERT_EQ(result, expected);
 }
+
+TEST(TestCaseSearchServer, TestParallelBatchOrder) {
+    vector<string> docs;
+    for (size_t i = 0; i < 200; ++i) {
+        string doc;
+        for (size_t j = 0; j < 1 + i % 7; ++j) doc += string(1, char('a' + (i + j) % 26)) + "x ";
+        docs.push_back(doc);
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+
+    vector<string> request;
+    for (size_t i = 0; i < 300; ++i)
+        request.push_back(string(1, char('a' + i % 26)) + "x " + string(1, char('a' + (i * 5) % 26)) + "x");
+
+    SearchServer seq(idx);
+    SearchServer par(idx);
+    par.setThreadCount(4);
+    ASSERT_EQ(par.search(request), seq.search(request));
+}
+
+TEST(TestCaseSearchServer, TestLimits) {
+    // двенадцатое слово есть только во втором документе
+    const vector<string> docs = { "a b c d e f g h i j k", "a b c d e f g h i j k l" };
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    const string query = "a b c d e f g h i j k l";
+    const vector<string> requests(1500, "a");
+
+    SearchServer srv(idx);
+    ASSERT_EQ(srv.searchQuery(query).size(), 2u);  // по ТЗ учитываются первые 10 слов
+    ASSERT_EQ(srv.search(requests).size(), SearchServer::MAX_REQUESTS);
+
+    srv.setMaxQueryWords(0);
+    srv.setMaxRequests(0);
+    ASSERT_EQ(srv.searchQuery(query), (vector<RelativeIndex>{ {1, 1.0f} }));
+    ASSERT_EQ(srv.search(requests).size(), requests.size());
+
+    srv.setMaxRequests(3);
+    ASSERT_EQ(srv.search(requests).size(), 3u);
+}
+
+TEST(TestCaseSearchServer, TestTopKMatchesFullSort) {
+    // много совпадений и длинные листы: отбор top-N с отсевом по block-max
+    // должен давать то же, что полная сортировка всех совпадений
+    vector<string> docs;
+    for (size_t i = 0; i < 3000; ++i) {
+        string doc;
+        for (size_t k = 0; k < 1 + (i * 7919) % 13; ++k) doc += "alpha ";
+        for (size_t k = 0; k < 1 + (i * 104729) % 5; ++k) doc += "beta ";
+        if (i % 4 == 0) doc += "gamma";
+        docs.push_back(doc);
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+
+    const vector<string> request = {"alpha beta", "gamma alpha", "beta"};
+    for (size_t qi = 0; qi < request.size(); ++qi) {
+        vector<string> words;
+        istringstream iss(request[qi]);
+        for (string w; iss >> w;) words.push_back(w);
+
+        map<size_t, size_t> abs;
+        for (size_t d = 0; d < docs.size(); ++d) {
+            size_t sum = 0;
+            bool all = true;
+            for (const auto& w : words) {
+                size_t cnt = 0;
+                for (const auto& e : idx.GetWordCount(w)) if (e.doc_id == d) cnt = e.count;
+                if (!cnt) { all = false; break; }
+                sum += cnt;
+            }
+            if (all) abs[d] = sum;
+        }
+        size_t mx = 0;
+        for (auto& [d, v] : abs) mx = max(mx, v);
+        vector<RelativeIndex> expected;
+        for (auto& [d, v] : abs) expected.push_back({ d, float(v) / float(mx) });
+        sort(expected.begin(), expected.end(), [](const RelativeIndex& a, const RelativeIndex& b){
+            if (a.rank == b.rank) return a.doc_id < b.doc_id;
+            return a.rank > b.rank;
+        });
+        expected.resize(min<size_t>(expected.size(), 5));
+
+        SearchServer srv(idx);
+        ASSERT_EQ(srv.search({ request[qi] }).front(), expected) << request[qi];
+    }
+}
+
+TEST(TestCaseSearchServer, TestIncrementalIndex) {
+    InvertedIndex idx;
+    idx.UpdateDocumentBase({
+        "milk milk milk milk water water water",
+        "milk water water",
+        "milk milk milk milk milk water water water water water",
+        "americano cappuccino"
+    });
+    SearchServer srv(idx);
+
+    idx.RemoveDocument(2);
+    idx.ReplaceDocument(3, "milk milk water");
+    idx.AddDocument("milk water water water water water water water");
+
+    const vector<vector<RelativeIndex>> expected = {
+        { {4, 1}, {0, 0.875f}, {1, 0.375f}, {3, 0.375f} }
+    };
+    ASSERT_EQ(srv.search({ "milk water" }), expected);
+}
+
+TEST(TestCaseSearchServer, TestResultCache) {
+    InvertedIndex idx;
+    idx.UpdateDocumentBase({
+        "milk milk milk milk water water water",
+        "milk water water",
+        "milk milk milk milk milk water water water water water",
+        "americano cappuccino"
+    });
+    SearchServer srv(idx);
+    srv.setCacheCapacity(1 << 20);
+
+    const vector<vector<RelativeIndex>> expected = {
+        { {2, 1}, {0, 0.7f}, {1, 0.3f} }
+    };
+    ASSERT_EQ(srv.search({ "milk water" }), expected);
+    // тот же набор слов в другом порядке и с повтором — попадание в кэш
+    ASSERT_EQ(srv.search({ "Water milk MILK" }), expected);
+    ASSERT_EQ(srv.cacheStats().hits, 1u);
+    ASSERT_EQ(srv.cacheStats().misses, 1u);
+
+    // другой лимит — другой ключ
+    srv.setResponsesLimit(1);
+    ASSERT_EQ(srv.search({ "milk water" })[0].size(), 1u);
+    ASSERT_EQ(srv.cacheStats().misses, 2u);
+    srv.setResponsesLimit(5);
+
+    // обновление индекса меняет поколение, устаревшая запись не отдаётся
+    idx.RemoveDocument(2);
+    const vector<vector<RelativeIndex>> after = {
+        { {0, 1}, {1, 3.0f / 7} }
+    };
+    ASSERT_EQ(srv.search({ "milk water" }), after);
+    ASSERT_EQ(srv.cacheStats().misses, 3u);
+
+    // слияние, выбрасывающее удалённые документы, меняет df (а с ним веса
+    // tfidf/bm25) — новое поколение
+    idx.AddDocument("tea");
+    ASSERT_EQ(srv.search({ "milk water" }), after);
+    idx.MergeSegments();
+    ASSERT_EQ(srv.search({ "milk water" }), after);
+    ASSERT_EQ(srv.cacheStats().misses, 5u);
+
+    // слияние без удалений результатов не меняет и кэш не сбрасывает
+    idx.AddDocument("coffee");
+    ASSERT_EQ(srv.search({ "milk water" }), after);
+    idx.MergeSegments();
+    ASSERT_EQ(srv.search({ "milk water" }), after);
+    ASSERT_EQ(srv.cacheStats().hits, 2u);
+    ASSERT_EQ(srv.cacheStats().misses, 6u);
+
+    // другой порог плотного OR — записи, посчитанные прежним путём, не отдаются
+    ASSERT_GT(srv.cacheStats().entries, 0u);
+    srv.setDenseFraction(0.0f);
+    ASSERT_EQ(srv.cacheStats().entries, 0u);
+
+    // крошечный бюджет — ничего не помещается
+    srv.setCacheCapacity(16);
+    ASSERT_EQ(srv.cacheStats().entries, 0u);
+}
+
+TEST(TestCaseSearchServer, TestResultCacheBm25Merge) {
+    vector<string> docs;
+    for (size_t i = 0; i < 8; ++i)
+        docs.push_back(string(i % 2 ? "water " : "milk ") + "water sugar" + string(i % 3, ' ') + " tea");
+    docs[4] = "water water milk";
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    idx.RemoveDocument(1);
+    idx.RemoveDocument(3);
+
+    SearchServer srv(idx);
+    srv.setRanking(SearchServer::Ranking::Bm25);
+    srv.setCacheCapacity(1 << 20);
+    srv.search({ "water milk" });
+
+    // слияние выбрасывает удалённые документы: df и веса другие, кэш не годится
+    idx.MergeSegments();
+    SearchServer fresh(idx);
+    fresh.setRanking(SearchServer::Ranking::Bm25);
+    const auto expected = fresh.search({ "water milk" });
+    ASSERT_EQ(srv.search({ "water milk" }), expected);
+    ASSERT_EQ(srv.cacheStats().hits, 0u);
+}
+
+TEST(TestCaseSearchServer, TestRanking) {
+    InvertedIndex idx;
+    idx.UpdateDocumentBase({
+        "cat dog dog dog dog dog dog dog",
+        "cat",
+        "common common common rare",
+        "common rare rare rare",
+        "common",
+        "common"
+    });
+    SearchServer srv(idx);
+
+    // по сумме вхождений — ничья, выигрывает меньший doc_id
+    ASSERT_EQ(srv.searchRaw("cat", 5)[0].doc_id, 0u);
+    ASSERT_EQ(srv.searchRaw("common rare", 5)[0].doc_id, 2u);
+
+    // BM25: при равной частоте короче документ — выше
+    srv.setRanking(SearchServer::parseRanking("bm25"));
+    auto bm25 = srv.searchRaw("cat", 5);
+    ASSERT_EQ(bm25.size(), 2u);
+    ASSERT_EQ(bm25[0].doc_id, 1u);
+    ASSERT_GT(bm25[0].rank, bm25[1].rank);
+
+    // TF-IDF: вхождения редкого слова весят больше частого
+    srv.setRanking(SearchServer::Ranking::TfIdf);
+    ASSERT_EQ(srv.searchRaw("common rare", 5)[0].doc_id, 3u);
+
+    ASSERT_THROW(SearchServer::parseRanking("pagerank"), runtime_error);
+}
+
+TEST(TestCaseSearchServer, TestRankingTopKMatchesFullSort) {
+    // поблочный подсчёт и отсев по оценкам сверху не должны менять выдачу
+    vector<string> docs;
+    for (size_t i = 0; i < 3000; ++i) {
+        string doc;
+        for (size_t k = 0; k < 1 + (i * 7919) % 13; ++k) doc += "alpha ";
+        for (size_t k = 0; k < 1 + (i * 104729) % 5; ++k) doc += "beta ";
+        for (size_t k = 0; k < (i * 31) % 17; ++k) doc += "filler ";
+        if (i % 4 == 0) doc += "gamma";
+        docs.push_back(doc);
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    idx.AddDocument("gamma gamma beta");
+    idx.RemoveDocument(8);
+
+    SearchServer srv(idx);
+    for (auto r : { SearchServer::Ranking::TfIdf, SearchServer::Ranking::Bm25 }) {
+        srv.setRanking(r);
+        for (const string q : {"alpha", "gamma", "alpha beta", "gamma alpha"}) {
+            auto full = srv.searchRaw(q, docs.size() + 1);
+            full.resize(min<size_t>(full.size(), 5));
+            ASSERT_EQ(srv.searchRaw(q, 5), full) << q;
+        }
+    }
+}
+
+TEST(TestCaseSearchServer, TestAnyMatchesFullScan) {
+    vector<string> docs;
+    for (size_t i = 0; i < 3000; ++i) {
+        string doc;
+        if (i % 3 == 0) for (size_t k = 0; k < 1 + i % 7; ++k) doc += "alpha ";
+        if (i % 5 == 0) for (size_t k = 0; k < 1 + i % 4; ++k) doc += "beta ";
+        if (i % 11 == 0) doc += "gamma gamma gamma gamma ";
+        doc += "filler";
+        docs.push_back(doc);
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    idx.AddDocument("alpha beta gamma");
+    idx.RemoveDocument(0);
+
+    SearchServer srv(idx);
+    const vector<string> words = {"alpha", "beta", "gamma", "sugar"};
+    // куча курсоров и плотный накопитель
+    for (float dense : {2.0f, 0.0f})
+    for (size_t msm : {1, 2, 3}) {
+        srv.setDenseFraction(dense);
+        // полный перебор: сумма вхождений найденных слов, не меньше msm слов
+        vector<RelativeIndex> expected;
+        map<size_t, pair<size_t, size_t>> acc; // doc -> (сумма, слов)
+        for (const auto& w : words)
+            for (const auto& e : idx.GetWordCount(w)) { acc[e.doc_id].first += e.count; ++acc[e.doc_id].second; }
+        for (auto& [d, v] : acc) if (v.second >= msm) expected.push_back({ d, float(v.first) });
+        sort(expected.begin(), expected.end(), [](const RelativeIndex& a, const RelativeIndex& b){
+            if (a.rank == b.rank) return a.doc_id < b.doc_id;
+            return a.rank > b.rank;
+        });
+        expected.resize(min<size_t>(expected.size(), 10));
+        ASSERT_EQ(srv.searchRaw("alpha beta gamma sugar", 10, SearchServer::Match::Any, msm), expected)
+            << msm << ' ' << dense;
+    }
+
+    // с отсевом по оценкам сверху выдача та же, что без ограничения
+    srv.setRanking(SearchServer::Ranking::Bm25);
+    srv.setDenseFraction(2.0f);
+    auto full = srv.searchRaw("alpha beta gamma", docs.size() + 1, SearchServer::Match::Any, 1);
+    full.resize(5);
+    ASSERT_EQ(srv.searchRaw("alpha beta gamma", 5, SearchServer::Match::Any, 1), full);
+
+    // плотный накопитель складывает вклады в другом порядке — ранги равны с точностью до округления
+    srv.setDenseFraction(0.0f);
+    auto dense = srv.searchRaw("alpha beta gamma", 5, SearchServer::Match::Any, 1);
+    ASSERT_EQ(dense.size(), full.size());
+    for (size_t i = 0; i < full.size(); ++i) ASSERT_NEAR(dense[i].rank, full[i].rank, 1e-5f);
+}
+
+static uint64_t dense_segments() {
+    return nlohmann::json::parse(Metrics::toJson())["counters"]["search_dense_segments_total"];
+}
+
+TEST(TestCaseSearchServer, TestMatchAnySparseSegment) {
+    // после слияния с удалениями остаётся сегмент {0, N - 1}: два документа на диапазон в N
+    const size_t N = 20000;
+    vector<string> docs(N, "filler");
+    docs.front() = "alpha beta";
+    docs.back() = "alpha gamma";
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    for (size_t i = 1; i + 1 < N; ++i) idx.RemoveDocument(i);
+    idx.MergeSegments();
+    ASSERT_EQ(idx.Snapshot()->segments.front().segment->docs.size(), 2u);
+
+    SearchServer srv(idx);
+    srv.setDenseFraction(0.5f);
+    const vector<RelativeIndex> expected = { {0, 2.0f}, {N - 1, 1.0f} };
+    const uint64_t before = dense_segments();
+    // листы покрывают больше половины документов сегмента, но не его диапазона doc_id
+    ASSERT_EQ(srv.searchRaw("alpha beta", 5, SearchServer::Match::Any, 1), expected);
+    ASSERT_EQ(dense_segments(), before);
+
+    srv.setDenseFraction(0.0f);
+    ASSERT_EQ(srv.searchRaw("alpha beta", 5, SearchServer::Match::Any, 1), expected);
+    if (Metrics::enabled()) {
+        ASSERT_EQ(dense_segments(), before + 1);
+    }
+}
+
+TEST(TestCaseSearchServer, TestPhrase) {
+    InvertedIndex idx;
+    idx.UpdateDocumentBase({
+        "milk and water",
+        "water and milk",
+        "milk water milk water",
+        "to be or not to be",
+        "be to or"
+    });
+    SearchServer srv(idx);
+
+    auto docs_of = [&](const string& q) {
+        vector<size_t> out;
+        for (const auto& r : srv.searchRaw(q, 10)) out.push_back(r.doc_id);
+        sort(out.begin(), out.end());
+        return out;
+    };
+    ASSERT_EQ(docs_of("milk water"), (vector<size_t>{0, 1, 2}));
+    ASSERT_EQ(docs_of("\"milk water\""), (vector<size_t>{2}));
+    ASSERT_EQ(docs_of(" \"water and milk\" "), (vector<size_t>{1}));
+    ASSERT_EQ(docs_of("\"to be\""), (vector<size_t>{3}));
+    ASSERT_EQ(docs_of("\"not to be\""), (vector<size_t>{3}));
+    ASSERT_EQ(docs_of("\"be to be\""), (vector<size_t>{}));
+
+    srv.setMatch(SearchServer::Match::Phrase);
+    ASSERT_EQ(docs_of("and milk"), (vector<size_t>{1}));
+
+    // позиции переживают добавление и слияние сегментов
+    idx.ReplaceDocument(0, "water and milk again");
+    idx.MergeSegments();
+    ASSERT_EQ(docs_of("and milk"), (vector<size_t>{0, 1}));
+
+    InvertedIndex plain;
+    plain.setStorePositions(false);
+    plain.UpdateDocumentBase({ "milk water" });
+    SearchServer no_positions(plain);
+    ASSERT_EQ(no_positions.searchRaw("milk water", 5).size(), 1u);
+    ASSERT_THROW(no_positions.searchRaw("\"milk water\"", 5), runtime_error);
+}
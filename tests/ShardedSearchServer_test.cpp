@@ -0,0 +1,117 @@
+#include "gtest/gtest.h"
+#include "InvertedIndex.h"
+#include "QueryServer.h"
+#include "SearchServer.h"
+#include "ShardedIndex.h"
+#include "ShardedSearchServer.h"
+#include <nlohmann/json.hpp>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+static vector<string> make_docs() {
+    // повторяющиеся счёты дают много равных рангов — проверяем порядок по doc_id
+    vector<string> docs;
+    for (size_t i = 0; i < 200; ++i) {
+        string d;
+        for (size_t k = 0; k < i % 7 + 1; ++k) d += "milk ";
+        for (size_t k = 0; k < i % 5; ++k) d += "water ";
+        if (i % 11 == 0) d += "sugar";
+        docs.push_back(d);
+    }
+    return docs;
+}
+
+static const vector<string> kRequests = {
+    "milk water", "milk", "sugar", "sugar water milk", "coffee", ""
+};
+
+static const SearchServer::Ranking kRankings[] = {
+    SearchServer::Ranking::Count, SearchServer::Ranking::TfIdf, SearchServer::Ranking::Bm25
+};
+
+TEST(TestCaseShardedSearchServer, TestMatchesSingleIndex) {
+    const auto docs = make_docs();
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    SearchServer single(idx, 7);
+
+    for (size_t n : {1, 3, 8}) {
+        ShardedIndex sharded(n);
+        sharded.setThreadCount(4);
+        sharded.UpdateDocumentBase(docs);
+        ASSERT_EQ(sharded.DocumentCount(), docs.size());
+        // TF-IDF и BM25 шардов взвешивают слова по статистике всего корпуса
+        for (auto ranking : kRankings) {
+            single.setRanking(ranking);
+            for (size_t s = 0; s < n; ++s) sharded.shard(s).server().setRanking(ranking);
+            for (size_t threads : {1, 4}) {
+                ShardedSearchServer srv(sharded.shards(), 7);
+                srv.setThreadCount(threads);
+                ASSERT_EQ(srv.search(kRequests), single.search(kRequests))
+                    << n << " shards, ranking " << static_cast<int>(ranking);
+            }
+        }
+    }
+}
+
+#ifdef __linux__
+TEST(TestCaseShardedSearchServer, TestRemoteShards) {
+    const auto docs = make_docs();
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    SearchServer single(idx, 7);
+
+    // два «процесса-шарда» на unix-сокетах, каждый со своим диапазоном документов
+    const size_t N = 2;
+    vector<unique_ptr<InvertedIndex>> indexes;
+    vector<unique_ptr<SearchServer>> servers;
+    vector<unique_ptr<QueryServer>> query_servers;
+    vector<unique_ptr<RemoteShard>> remotes;
+    vector<thread> loops;
+    for (size_t s = 0; s < N; ++s) {
+        const auto [begin, end] = ShardedIndex::shard_range(docs.size(), N, s);
+        indexes.push_back(make_unique<InvertedIndex>());
+        indexes.back()->UpdateDocumentBase(vector<string>(docs.begin() + begin, docs.begin() + end));
+        servers.push_back(make_unique<SearchServer>(*indexes.back()));
+        query_servers.push_back(make_unique<QueryServer>(*servers.back(), 2));
+        query_servers.back()->setDocOffset(begin);
+        const string path = (filesystem::temp_directory_path()
+                             / ("search_engine_shard" + to_string(s) + ".sock")).string();
+        query_servers.back()->listen("unix:" + path);
+        loops.emplace_back([qs = query_servers.back().get()]{ qs->run(); });
+        remotes.push_back(make_unique<RemoteShard>("unix:" + path));
+    }
+
+    ShardedSearchServer srv({ remotes[0].get(), remotes[1].get() }, 7);
+    srv.setThreadCount(2);
+    vector<vector<vector<RelativeIndex>>> results, expected;
+    for (auto ranking : kRankings) {
+        single.setRanking(ranking);
+        for (auto& server : servers) server->setRanking(ranking);
+        results.push_back(srv.search(kRequests));
+        expected.push_back(single.search(kRequests));
+    }
+
+    // шард с известным ранжированием Count: без первого прохода — по запросу на шард
+    single.setRanking(SearchServer::Ranking::Count);
+    for (auto& server : servers) server->setRanking(SearchServer::Ranking::Count);
+    RemoteShard count0(remotes[0]->address(), SearchServer::Ranking::Count);
+    RemoteShard count1(remotes[1]->address(), SearchServer::Ranking::Count);
+    ShardedSearchServer count_srv({ &count0, &count1 }, 7);
+    auto queries = [&] { return json::parse(query_servers[0]->handle(R"({"cmd": "stats"})"))["queries"].get<size_t>(); };
+    const size_t before = queries();
+    results.push_back(count_srv.search(kRequests));
+    expected.push_back(single.search(kRequests));
+    const size_t handled = queries() - before;
+
+    for (auto& qs : query_servers) qs->stop();
+    for (auto& t : loops) t.join();
+    ASSERT_EQ(results, expected);
+    ASSERT_EQ(handled, kRequests.size());
+}
+#endif
@@ -0,0 +1,96 @@
+#include "gtest/gtest.h"
+#include "Tokenizer.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static vector<string> tokens(const string& s) {
+    vector<string> words;
+    Tokenizer tok(s);
+    string_view w;
+    while (tok.next(w)) words.emplace_back(w);
+    return words;
+}
+
+TEST(TestCaseTokenizer, TestBasic) {
+    const vector<string> expected = {"london", "is", "the", "capital", "of", "great", "britain"};
+    ASSERT_EQ(tokens("  London is the CAPITAL of great-Britain!\n"), expected);
+    ASSERT_TRUE(tokens("").empty());
+    ASSERT_TRUE(tokens("123 ,.;\t\n").empty());
+}
+
+TEST(TestCaseTokenizer, TestLongWordSkipped) {
+    const string longest(Tokenizer::MAX_WORD_LEN, 'a');
+    const string too_long(Tokenizer::MAX_WORD_LEN + 1, 'b');
+    const vector<string> expected = {"x", longest, "y"};
+    ASSERT_EQ(tokens("x " + too_long + " " + longest + " y"), expected);
+}
+
+TEST(TestCaseTokenizer, TestUnicode) {
+    const vector<string> expected = {
+        "москва", "москва", "ёлка", "école", "łódź", "straße", "ѕ", "іван", "x", "y",
+    };
+    ASSERT_EQ(tokens("МОСКВА — Москва. ЁЛКА, École; ŁÓDŹ straße «Ѕ» ІВАН x\xd0 y\xff"), expected);
+    // разложенное «й» (и + U+0306) — одно слово
+    ASSERT_EQ(tokens("Мои\xcc\x86 край"), (vector<string>{ "мои\xcc\x86", "край" }));
+    // предел длины — в символах, а не в байтах
+    string longest, too_long;
+    for (size_t i = 0; i < Tokenizer::MAX_WORD_LEN; ++i) longest += "Я";
+    too_long = longest + "я";
+    string longest_lower;
+    for (size_t i = 0; i < Tokenizer::MAX_WORD_LEN; ++i) longest_lower += "я";
+    ASSERT_EQ(tokens(too_long + " " + longest), (vector<string>{ longest_lower }));
+}
+
+// Эталон: текст собирается из «символов» с заранее известным смыслом —
+// буква в нижнем регистре или разделитель (пустая строка).
+TEST(TestCaseTokenizer, TestMatchesReference) {
+    const vector<pair<string, string>> symbols = {
+        {"a", "a"}, {"b", "b"}, {"X", "x"}, {"Z", "z"}, {" ", ""}, {"\t", ""}, {"\n", ""},
+        {".", ""}, {"-", ""}, {"0", ""}, {"п", "п"}, {"П", "п"}, {"é", "é"}, {"É", "é"},
+        {"Ё", "ё"}, {"Ÿ", "ÿ"}, {"ſ", "s"}, {"—", ""}, {"×", ""}, {"😀", ""}, {"\xff", ""},
+        {"\xd0", ""}, {"\xe2\x80", ""},
+    };
+    mt19937 rng(12345);
+    for (int iter = 0; iter < 500; ++iter) {
+        string s;
+        vector<string> expected;
+        string word;
+        size_t chars = 0;
+        auto end_word = [&] {
+            if (!word.empty() && chars <= Tokenizer::MAX_WORD_LEN) expected.push_back(word);
+            word.clear();
+            chars = 0;
+        };
+        const size_t len = rng() % 400;
+        for (size_t i = 0; i < len; ++i) {
+            // изредка длинные серии букв, чтобы задеть лимит длины слова
+            const size_t repeat = rng() % 50 == 0 ? 90 + rng() % 20 : 1;
+            const auto& [text, lower] = symbols[rng() % symbols.size()];
+            for (size_t r = 0; r < repeat; ++r) {
+                s += text;
+                if (lower.empty()) end_word();
+                else { word += lower; ++chars; }
+            }
+        }
+        end_word();
+        ASSERT_EQ(tokens(s), expected) << s;
+    }
+}
+
+// длинный ASCII-текст с вкраплениями кириллицы: границы 32-байтовых блоков
+// проверки ASCII приходятся на разные места слов
+TEST(TestCaseTokenizer, TestAsciiBlocks) {
+    for (size_t shift = 0; shift < 40; ++shift) {
+        string s(shift, ' ');
+        vector<string> expected;
+        for (size_t i = 0; i < 50; ++i) {
+            const string w = i % 5 == 0 ? "Wordслово" : "word" + string(i % 7, 'x');
+            s += w + (i % 3 ? " " : ",\n");
+            expected.push_back(i % 5 == 0 ? "wordслово" : w);
+        }
+        ASSERT_EQ(tokens(s), expected) << shift;
+    }
+}